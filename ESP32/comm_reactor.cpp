@@ -0,0 +1 @@
+../comm_reactor.cpp
\ No newline at end of file
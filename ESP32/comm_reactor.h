@@ -0,0 +1 @@
+../comm_reactor.h
\ No newline at end of file
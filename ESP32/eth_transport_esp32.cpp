@@ -6,9 +6,6 @@
 #include "utils.h"
 
 
-constexpr const int max_pkt_size = 1512;
-static uint8_t buffer[max_pkt_size];
-
 eth_transport_esp32::eth_transport_esp32(const uint8_t mac[6])
 {
 	memcpy(mac_addr, mac, 6);
@@ -44,28 +41,30 @@ bool eth_transport_esp32::transmit(const uint8_t *const data, const size_t n_byt
 	return rc == n_bytes;
 }
 
-std::pair<uint8_t *, size_t> eth_transport_esp32::get(const int timeout)
+size_t eth_transport_esp32::get(eth_frame **const out, const size_t n_max, const int timeout)
 {
-	uint8_t *pkt         = nullptr;
-	size_t   packet_size = 0;
+	if (n_max == 0)
+		return 0;
+
+	eth_frame *f = pool.get();
+	if (!f) {
+		DOLOG(log_ss::LS_ETH, "no free frame buffers");
+		return 0;
+	}
+
 	auto     start       = millis();
 	int      sleep_n_ms  = 1;
 	while(millis() - start < timeout) {
 		int rc = 0;
 		{
 			my_unique_lock lck(&w5500_lock);
-			rc = w5500_instance->readFrame(buffer, sizeof buffer);
+			rc = w5500_instance->readFrame(f->data, sizeof f->data);
 		}
 		if (rc > 0) {
 			pkt_cnt_rx++;
-			pkt = new uint8_t[rc];
-			if (!pkt) {
-				DOLOG(log_ss::LS_ETH, "malloc issue");
-				return { nullptr, 0 };
-			}
-			memcpy(pkt, buffer, rc);
-			packet_size = rc;
-			break;
+			f->n   = rc;
+			out[0] = f;
+			return 1;
 		}
 		else if (rc == -1) {
 			DOLOG(log_ss::LS_ETH, "receive error");
@@ -74,5 +73,7 @@ std::pair<uint8_t *, size_t> eth_transport_esp32::get(const int timeout)
 		if (sleep_n_ms < 64)
 			sleep_n_ms <<= 1;
 	}
-	return { pkt, packet_size };
+
+	pool.put(f);
+	return 0;
 }
@@ -0,0 +1 @@
+../event_scheduler.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../fp11.cpp
\ No newline at end of file
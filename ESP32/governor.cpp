@@ -0,0 +1 @@
+../governor.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../governor.h
\ No newline at end of file
@@ -0,0 +1 @@
+../tx_flush_timer.h
\ No newline at end of file
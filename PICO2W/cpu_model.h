@@ -0,0 +1 @@
+../cpu_model.h
\ No newline at end of file
@@ -0,0 +1 @@
+../event_scheduler.h
\ No newline at end of file
@@ -0,0 +1 @@
+../fp11.h
\ No newline at end of file
@@ -0,0 +1 @@
+../spsc_ring.h
\ No newline at end of file
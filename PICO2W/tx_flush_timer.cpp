@@ -0,0 +1 @@
+../tx_flush_timer.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../eth_frame.h
\ No newline at end of file
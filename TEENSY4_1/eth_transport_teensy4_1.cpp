@@ -39,15 +39,25 @@ bool eth_transport_teensy4_1::transmit(const uint8_t *const data, const size_t n
 	return qn::EthernetFrame.send(data, n_bytes);
 }
 
-std::pair<uint8_t *, size_t> eth_transport_teensy4_1::get(const int timeout)
+size_t eth_transport_teensy4_1::get(eth_frame **const out, const size_t n_max, const int timeout)
 {
-	uint8_t *out = new uint8_t[max_pkt_size];
-	if (xQueueReceive(pkt_queue, out, timeout / portTICK_PERIOD_MS) == pdPASS)
-		return { out, max_pkt_size };
+	if (n_max == 0)
+		return 0;
 
-	delete [] out;
+	eth_frame *f = pool.get();
+	if (!f) {
+		DOLOG(log_ss::LS_ETH, "no free frame buffers");
+		return 0;
+	}
+
+	if (xQueueReceive(pkt_queue, f->data, timeout / portTICK_PERIOD_MS) == pdPASS) {
+		f->n   = max_pkt_size;
+		out[0] = f;
+		return 1;
+	}
 
-	return { nullptr, 0 };
+	pool.put(f);
+	return 0;
 }
 
 void eth_transport_teensy4_1::set_trace(const bool state)
@@ -19,5 +19,5 @@ public:
 	std::string identifier() const override;
 
 	bool transmit(const uint8_t *const data, const size_t n_bytes) override;
-	std::pair<uint8_t *, size_t> get(const int timeout) override;
+	size_t get(eth_frame **const out, const size_t n_max, const int timeout) override;
 };
@@ -192,6 +192,7 @@ void benchmark(console *const cnsl, bus *const b, kek_event_t *const stop_event,
 		uint64_t start_ts1    = get_us();
 		size_t   cycle_count  = 0;
 		uint64_t duration     = 0;
+		c->set_allow_block_loops(false);  // duration is calculated per instruction
 		while(load_relaxed_p(stop_event) == EVENT_NONE) {
 			uint16_t pc = c->getPC();
 			cycle_count++;
@@ -205,6 +206,7 @@ void benchmark(console *const cnsl, bus *const b, kek_event_t *const stop_event,
 		uint64_t count_slower = get_count(b) * timing_comp1;
 
 		reset_benchmark(b, with_mmu);
+		c->set_allow_block_loops(true);
 
 		uint64_t start_ts2    = get_us();
 		*stop_event = EVENT_NONE;
@@ -70,6 +70,8 @@ JsonDocument bus::serialize() const
 	if (c)
 		j_out["cpu"]    = c->serialize();
 
+	j_out["cpu-model"] = model->name;
+
 	if (rl02_)
 		j_out["rl02"]   = rl02_->serialize();
 
@@ -92,6 +94,12 @@ bus *bus::deserialize(const JsonDocument j, console *const cnsl, kek_event_t *co
 {
 	bus *b = new bus();
 
+	if (j.containsKey("cpu-model")) {
+		auto model = find_cpu_model(j["cpu-model"].as<std::string>());
+		if (model.has_value())
+			b->set_cpu_model(model.value());
+	}
+
 	memory *m = nullptr;
 	if (j.containsKey("memory")) {
 		m = memory::deserialize(j["memory"]);
@@ -135,6 +143,7 @@ bus *bus::deserialize(const JsonDocument j, console *const cnsl, kek_event_t *co
 
 FLASHMEM void bus::show_state(console *const cnsl) const
 {
+	cnsl->put_string_lf(format("CPU model: PDP-%s", model->name));
 	cnsl->put_string_lf(format("Microprogram break register: %06o", microprogram_break_register));
 	cnsl->put_string_lf(format("Console switches: %06o", console_switches));
 	cnsl->put_string_lf(format("Console LEDs: %06o", console_leds));
@@ -222,6 +231,7 @@ void bus::add_mmu(mmu *const mmu_)
 	this->mmu_ = mmu_;
 
 	mmu_->begin(m, c);
+	mmu_->set_cpu_model(*model);
 }
 
 void bus::add_cpu(cpu *const c)
@@ -229,10 +239,55 @@ void bus::add_cpu(cpu *const c)
 	delete this->c;
 	this->c = c;
 
+	c->set_cpu_model(*model);
+
 	if (mmu_)
 		mmu_->begin(m, c);
 }
 
+void bus::set_cpu_model(const cpu_model_t new_model)
+{
+	model = &cpu_models[new_model];
+
+	DOLOG(log_ss::LS_BUS, "CPU model: PDP-%s", model->name);
+
+	mmu_->set_cpu_model(*model);
+	if (c)
+		c->set_cpu_model(*model);
+}
+
+// registers that the selected CPU model does not have: accessing them times out
+bool bus::is_absent_register(const uint16_t a) const
+{
+	if (a == ADDR_CPU_ERR)
+		return !model->has_cpuerr;
+
+	if (a == ADDR_STACKLIM || a == ADDR_STACKLIM + 1)
+		return !model->has_stack_limit;
+
+	if (a == ADDR_PIR || a == ADDR_PIR + 1)
+		return !model->has_pir;
+
+	if (a == ADDR_MMR3)
+		return !model->has_id_space && !model->has_22bit;
+
+	if (a >= ADDR_PDR_SV_START && a < ADDR_PAR_SV_END)
+		return !model->has_supervisor;
+
+	if (model->has_22bit == false) {
+		if (a >= ADDR_SYSSIZE && a < ADDR_SYSTEM_ID + 2)  // system size, system id
+			return true;
+		if (a == ADDR_MICROPROG_BREAK_REG || a == ADDR_MICROPROG_BREAK_REG + 1)
+			return true;
+		if (a >= 0177740 && a <= 0177753)  // cache control, MAINT
+			return true;
+		if (a >= 0170200 && a <= 0170377)  // unibus map
+			return true;
+	}
+
+	return false;
+}
+
 #if !defined(TEENSY4_1)
 void bus::add_tm11(tm_11 *const tm11)
 {
@@ -319,6 +374,12 @@ uint16_t bus::read_IO(const uint16_t a, const word_mode_t word_mode, const int r
 		return 0;
 	}
 
+	if (model->model != cm_11_70 && is_absent_register(a)) [[unlikely]] {
+		DOLOG(log_ss::LS_BUS_IO, "READ-I/O %06o not available on a PDP-%s", a, model->name);
+		c->trap(004);  // no such i/o
+		throw 1;
+	}
+
 	if (a == ADDR_CPU_ERR) { // cpu error register
 		uint16_t temp = mmu_->getCPUERR() & 0xff;
 		DOLOG(log_ss::LS_BUS_IO, "READ-I/O CPU error: %03o", temp);
@@ -570,7 +631,7 @@ void bus::verify_pointer_bounds(const uint32_t m_offset, const int page_index)
 	}
 }
 
-uint16_t bus::read(const uint16_t addr_in, const word_mode_t word_mode, const int run_mode, const d_i_space_t space_in)
+uint16_t bus::read(const uint16_t addr_in, const word_mode_t word_mode, const int run_mode, const d_i_space_t space_in, std::optional<std::pair<uint32_t, int> > *const physical)
 {
 	auto     space    = mmu_->get_use_data_space(run_mode) ? space_in : i_space;
 	const auto [ m_offset, page_index ] = mmu_->calculate_physical_address(run_mode, addr_in, false, space);
@@ -601,6 +662,9 @@ uint16_t bus::read(const uint16_t addr_in, const word_mode_t word_mode, const in
 		temp = m->read_word(m_offset);
 	}
 
+	if (physical)
+		*physical = { m_offset, page_index };
+
 	DOLOG(log_ss::LS_BUS, "READ from %06o/%07o %c %c: %06o (%d)", addr_in, m_offset, space == d_space ? 'D' : 'I', word_mode == wm_byte ? 'B' : 'W', temp, run_mode);
 
 	return temp;
@@ -608,6 +672,12 @@ uint16_t bus::read(const uint16_t addr_in, const word_mode_t word_mode, const in
 
 bool bus::write_IO(const uint16_t a, const word_mode_t word_mode, const int page, uint16_t value)
 {
+	if (model->model != cm_11_70 && is_absent_register(a)) [[unlikely]] {
+		DOLOG(log_ss::LS_BUS_IO, "WRITE-I/O %06o not available on a PDP-%s", a, model->name);
+		c->trap(004);  // no such i/o
+		throw 9;
+	}
+
 	if (word_mode == wm_byte) {
 		if (a == ADDR_PSW || a == ADDR_PSW + 1) { // PSW
 			DOLOG(log_ss::LS_BUS_IO, "WRITE-I/O PSW %s: %03o", a & 1 ? "MSB" : "LSB", value);
@@ -883,6 +953,43 @@ bool bus::write(const uint16_t addr_in, const word_mode_t word_mode, const uint1
 	return false;
 }
 
+std::optional<std::pair<uint32_t, int> > bus::get_ram_span(const uint16_t addr_in, const uint16_t n_bytes, const int run_mode, const d_i_space_t space_in)
+{
+	if ((addr_in & 1) || n_bytes < 2 || (addr_in & 8191) + n_bytes > 8192)
+		return { };
+
+	auto space = mmu_->get_use_data_space(run_mode) ? space_in : i_space;
+	auto first = mmu_->probe_physical_address(run_mode, addr_in,               space);
+	auto last  = mmu_->probe_physical_address(run_mode, addr_in + n_bytes - 2, space);
+
+	if (first.has_value() == false || last.has_value() == false)
+		return { };
+
+	uint32_t m_last = last.value().first;
+	if (m_last != first.value().first + n_bytes - 2)  // wrapped at 18 bit
+		return { };
+
+	if (m_last >= mmu_->get_io_base() || m_last + 2 > m->get_memory_size())
+		return { };
+
+	return first;
+}
+
+// address translation, access checks, bounds and alignment were all done by the 'read'
+void bus::write_rmw(const uint16_t addr_in, const word_mode_t word_mode, const uint16_t value, const std::pair<uint32_t, int> & physical)
+{
+	const auto [ m_offset, page_index ] = physical;
+
+	DOLOG(log_ss::LS_BUS, "WRITE to %06o/%07o %c: %06o (RMW)", addr_in, m_offset, word_mode == wm_byte ? 'B' : 'W', value);
+
+	mmu_->set_page_written_to(page_index);
+
+	if (word_mode == wm_byte)
+		m->write_byte(m_offset, value);
+	else
+		m->write_word(m_offset, value);
+}
+
 void bus::write_unibus_word(const uint32_t a, const uint16_t v)
 {
 	DOLOG(log_ss::LS_BUS, "write_unibus_word[%08o]=%06o (%04x)", a, v, v);
@@ -979,3 +1086,11 @@ void bus::write_unibus_byte(const uint32_t a, const uint8_t v)
 	if (a < m->get_memory_size())
 		m->write_byte(a, v);
 }
+
+void bus::write_unibus_block(const uint32_t a, const uint8_t *const data, const uint32_t n)
+{
+	DOLOG(log_ss::LS_BUS, "write_unibus_block[%08o] %u bytes", a, n);
+	uint32_t size = m->get_memory_size();
+	if (a < size)
+		m->write_block(a, data, std::min(n, size - a));
+}
@@ -12,6 +12,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "cpu_model.h"
 #include "device.h"
 #include "dc11.h"
 #include "dz11.h"
@@ -81,6 +82,8 @@ private:
 	rp06    *rp06_   { nullptr };
 	deqna   *deqna_  { nullptr };
 
+	const cpu_model_features_t *model { &cpu_models[cm_11_70] };
+
 	uint16_t microprogram_break_register { 0 };
 
 	uint16_t console_switches { 0 };
@@ -90,6 +93,7 @@ private:
 	bool     write_IO(const uint16_t a, const word_mode_t word_mode,                                              const int page, uint16_t value);
 
 	void     verify_pointer_bounds(const uint32_t m_offset, const int page_index);
+	bool     is_absent_register(const uint16_t a) const;
 
 public:
 	bus();
@@ -111,6 +115,9 @@ public:
 	void     set_debug_mode      () { console_switches |= 128; }
 	uint16_t get_console_leds    () { return console_leds;     }
 
+	void set_cpu_model(const cpu_model_t new_model);
+	const cpu_model_features_t & get_cpu_model() const { return *model; }
+
 	void set_memory_size(const int n_pages);
 	uint32_t get_memory_size() const { return m->get_memory_size(); }
 
@@ -146,7 +153,9 @@ public:
 	rp06   *getRP06()   { return rp06_;   }
 	deqna  *getDEQNA()  { return deqna_;  }
 
-	uint16_t read(const uint16_t a, const word_mode_t word_mode, const int run_mode, const d_i_space_t s = i_space);
+	uint16_t read(const uint16_t a, const word_mode_t word_mode, const int run_mode, const d_i_space_t s = i_space, std::optional<std::pair<uint32_t, int> > *const physical = nullptr);
+	// physical offset + page index of 'n_bytes' at 'a' if they are contiguous RAM in one page that can be accessed without any trap
+	std::optional<std::pair<uint32_t, int> > get_ram_span(const uint16_t a, const uint16_t n_bytes, const int run_mode, const d_i_space_t s);
 	uint8_t  read_byte(const uint16_t a) override { return read(a, wm_byte, c->getPSW_runmode()); }
 	uint16_t read_word(const uint16_t a, const d_i_space_t s);
 	uint16_t read_word(const uint16_t a) override { return read_word(a, i_space); }
@@ -157,10 +166,14 @@ public:
 	uint16_t read_physical_byte(const uint32_t a);
 
 	bool     write(const uint16_t a, const word_mode_t word_mode, const uint16_t value, const int run_mode, const d_i_space_t s = i_space);
+	// write-back of a value obtained via 'read' with 'physical' set
+	void     write_rmw(const uint16_t a, const word_mode_t word_mode, const uint16_t value, const std::pair<uint32_t, int> & physical);
 	void     write_unibus_byte(const uint32_t a, const uint8_t value);
 	void     write_byte(const uint16_t a, const uint8_t value) override { write(a, wm_byte, value, c->getPSW_runmode()); }
 	void     write_word(const uint16_t a, const uint16_t value, const d_i_space_t s);
 	void     write_word(const uint16_t a, const uint16_t value) override { write_word(a, value, i_space); }
 	void     write_physical(const uint32_t a, const uint16_t value);
 	void     write_unibus_word(const uint32_t a, const uint16_t value);
+	// DMA of 'n' bytes, what does not fit in RAM is ignored
+	void     write_unibus_block(const uint32_t a, const uint8_t *const data, const uint32_t n);
 };
@@ -15,6 +15,8 @@
 #endif
 #if IS_POSIX
 #include "comm_posix_tty.h"
+#include "comm_pty.h"
+#include "comm_unix_socket.h"
 #endif
 #if !defined(BUILD_FOR_PICO2W) && !defined(TEENSY4_1)
 #include "comm_tcp_socket_client.h"
@@ -36,6 +38,28 @@ comm::~comm()
 {
 }
 
+size_t comm::get_bytes(uint8_t *const out, const size_t n)
+{
+	size_t count = 0;
+	while(count < n && has_data())
+		out[count++] = get_byte();
+
+	return count;
+}
+
+void comm::set_notifier(const std::function<void()> & f)
+{
+	my_unique_lock lck(&notifier_lock);
+	notifier = f;
+}
+
+void comm::notify()
+{
+	my_unique_lock lck(&notifier_lock);
+	if (notifier)
+		notifier();
+}
+
 void comm::println(const char *const s)
 {
 	send_data(reinterpret_cast<const uint8_t *>(s), strlen(s));
@@ -84,6 +108,10 @@ comm *comm::deserialize(const JsonVariantConst j, bus *const)
 #if IS_POSIX
 	else if (type == "posix")
                 d = comm_posix_tty::deserialize(j);
+	else if (type == "unix-socket")
+                d = comm_unix_socket::deserialize(j);
+	else if (type == "pty")
+                d = comm_pty::deserialize(j);
 #endif
 	else {
 		DOLOG(log_ss::LS_COMM, "comm::deserialize: \"%s\" not de-serialized", type.c_str());
@@ -6,6 +6,8 @@
 #include "gen.h"
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -21,6 +23,9 @@
 
 class bus;
 
+constexpr const size_t comm_tx_buffer_size = 256;   // output per line that is sent in one go
+constexpr const int    comm_tx_flush_us    = 1000;  // emulated time without new output before sending it
+
 class comm
 {
 private:
@@ -28,6 +33,12 @@ private:
 	static SC16IS752 *ser2_inst_1;
 	static SC16IS752 *ser2_inst_2;
 #endif
+	my_lock               notifier_lock;
+	std::function<void()> notifier;
+
+protected:
+	void            notify();  // new data or a change in connection state
+
 public:
 	comm();
 	virtual ~comm();
@@ -49,25 +60,36 @@ public:
 
 	virtual bool    has_data() = 0;
 	virtual uint8_t get_byte() = 0;
+	// returns up to 'n' bytes of what is available
+	virtual size_t  get_bytes(uint8_t *const out, const size_t n);
 
 	virtual void    send_data(const uint8_t *const in, const size_t n) = 0;
 
+	// backends that invoke the notifier themselves do not need to be polled
+	virtual bool    can_notify() const { return false; }
+	void            set_notifier(const std::function<void()> & f);
+
         void            println(const char *const s);
         void            println(const std::string & in);
 };
 
+// 'lock' is only for configuration changes: using a channel only takes the
+// lock of that channel
 struct comm_io
 {
-	mutable my_lock     lock;
-	std::vector<comm *> channels;
+	mutable my_lock       lock;
+	std::vector<comm *>   channels;
+	std::unique_ptr<my_lock[]> channel_locks;
+	mutable std::vector<std::vector<uint8_t> > tx_buffers;  // see queue_data()
+	std::function<void()> notifier;
 
 	comm_io(const int max_n) {
 		channels.resize(max_n);
+		channel_locks.reset(new my_lock[max_n]);
+		tx_buffers.resize(max_n);
 	}
 
-	comm_io(const comm_io & input) {
-		channels = std::move(input.channels);
-	}
+	comm_io(const comm_io &) = delete;
 
 	~comm_io() {
 		for(auto & c: channels)
@@ -100,67 +122,143 @@ struct comm_io
 	}
 #endif
 
+	// invoked with 'lock' held. a pointer in 'channels' is only changed with
+	// both 'lock' and the channel lock held, so either is enough to use it
+	comm *take_device(const int idx) {
+		my_unique_lock lck(&channel_locks[idx]);
+		comm *p = channels[idx];
+		channels[idx] = nullptr;
+		tx_buffers[idx].clear();
+		return p;
+	}
+
 	bool set_device(const int idx, comm *const p) {
 		my_unique_lock lck(&lock);
-		if (channels[idx] && channels[idx]->need_dealloc() == true)
-			delete channels[idx];
+		comm *old = take_device(idx);
+		if (old && old->need_dealloc() == true)
+			delete old;
+
+		p->set_notifier(notifier);
+		bool rc = p->begin();
+
+		my_unique_lock lck_channel(&channel_locks[idx]);
 		channels[idx] = p;
-		return p->begin();
+		return rc;
 	}
 
-	bool is_defined(const int idx) {
+	// 'f' is invoked from the backend threads when any of the channels has news
+	void set_notifier(const std::function<void()> & f) {
 		my_unique_lock lck(&lock);
+		notifier = f;
+		for(auto & c: channels) {
+			if (c)
+				c->set_notifier(f);
+		}
+	}
+
+	// false when one or more channels must be polled
+	bool can_notify() {
+		my_unique_lock lck(&lock);
+		for(auto & c: channels) {
+			if (c && c->can_notify() == false)
+				return false;
+		}
+		return true;
+	}
+
+	bool is_defined(const int idx) {
+		my_unique_lock lck(&channel_locks[idx]);
 		return channels[idx] != nullptr;
 	}
 
 	void unload_device(const int idx) {
 		my_unique_lock lck(&lock);
-		delete channels[idx];
-		channels[idx] = nullptr;
+		delete take_device(idx);
 	}
 
 	std::string get_identifier(const int idx) {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
 		if (channels[idx])
 			return channels[idx]->get_identifier();
 		return "NOT CONNECTED";
 	}
 
 	bool is_connected(const int idx) {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
 		if (channels[idx])
 			return channels[idx]->is_connected();
 		return false;
 	}
 
 	bool has_data(const int idx) {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
 		if (channels[idx])
 			return channels[idx]->has_data();
 		return false;
 	}
 
 	uint8_t get_byte(const int idx) {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
 		if (channels[idx])
 			return channels[idx]->get_byte();
 		return 0xee;
 	}
 
+	size_t get_bytes(const int idx, uint8_t *const out, const size_t n) {
+		my_unique_lock lck(&channel_locks[idx]);
+		if (channels[idx])
+			return channels[idx]->get_bytes(out, n);
+		return 0;
+	}
+
+	// invoked with the channel lock held
+	void flush_ll(const int idx) const {
+		auto & buffer = tx_buffers[idx];
+		if (buffer.empty())
+			return;
+		if (channels[idx])
+			channels[idx]->send_data(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	// output of the emulated devices, one character at a time, is collected
+	// here and then sent in one go. the caller arranges for a flush() (see
+	// tx_flush_timer).
+	void queue_data(const int idx, const uint8_t c) {
+		my_unique_lock lck(&channel_locks[idx]);
+		auto & buffer = tx_buffers[idx];
+		buffer.push_back(c);
+		if (buffer.size() >= comm_tx_buffer_size)
+			flush_ll(idx);
+	}
+
+	void flush(const int idx) {
+		my_unique_lock lck(&channel_locks[idx]);
+		flush_ll(idx);
+	}
+
+	void flush_all() {
+		for(size_t i=0; i<channels.size(); i++)
+			flush(i);
+	}
+
 	void send_data(const int idx, const uint8_t *const in, const size_t n) const {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
+		flush_ll(idx);
 		if (channels[idx])
 			channels[idx]->send_data(in, n);
 	}
 
         void println(const int idx, const char *const s) const {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
+		flush_ll(idx);
 		if (channels[idx])
 			channels[idx]->println(s);
 	}
 
         void println(const int idx, const std::string & in) const {
-		my_unique_lock lck(&lock);
+		my_unique_lock lck(&channel_locks[idx]);
+		flush_ll(idx);
 		if (channels[idx])
 			channels[idx]->println(in);
 	}
@@ -67,39 +67,53 @@ bool comm_posix_tty::begin()
 		return false;
 	}
 
-	return true;
+	return comm_reactor::get_instance()->add(fd, this);
 }
 
 comm_posix_tty::~comm_posix_tty()
 {
+	comm_reactor::get_instance()->remove_handler(this);
+
+	my_unique_lock lck(&fd_lock);
 	if (fd != -1)
 		close(fd);
 }
 
 bool comm_posix_tty::is_connected()
 {
+	my_unique_lock lck(&fd_lock);
 	return fd != -1;
 }
 
 bool comm_posix_tty::has_data()
 {
-	if (fd == -1)
-		return false;
-
-	pollfd fds[] { { fd, POLLIN, 0 } };
-	return poll(fds, 1, 0);
+	return rx_has_data();
 }
 
 uint8_t comm_posix_tty::get_byte()
 {
-	uint8_t c = 0;
-	if (read(fd, &c, 1) <= 0) {
+	return rx_get_byte();
+}
+
+size_t comm_posix_tty::get_bytes(uint8_t *const out, const size_t n)
+{
+	return rx_read(out, n);
+}
+
+void comm_posix_tty::handle_readable(const int ready_fd)
+{
+	if (receive(ready_fd) == false) {
 		DOLOG(log_ss::LS_COMM, "com_posix_tty cannot read");
-		close(fd);
-		fd = -1;
+		comm_reactor::get_instance()->remove(ready_fd);
+
+		my_unique_lock lck(&fd_lock);
+		if (fd == ready_fd) {
+			close(fd);
+			fd = -1;
+		}
 	}
 
-	return c;
+	notify();
 }
 
 void comm_posix_tty::send_data(const uint8_t *const in, const size_t n)
@@ -107,12 +121,18 @@ void comm_posix_tty::send_data(const uint8_t *const in, const size_t n)
 	const uint8_t *p   = in;
 	size_t         len = n;
 
+	// held while writing so that the reactor thread cannot close (and the
+	// number cannot be reused) meanwhile
+	my_unique_lock lck(&fd_lock);
+	if (fd == -1)
+		return;
+
 	while(len > 0) {
 		int rc = write(fd, p, len);
-		if (rc <= 0) {  // TODO error checking
-			DOLOG(log_ss::LS_COMM, "com_posix_tty cannot write");
-			close(fd);
-			fd = -1;
+		if (rc == -1 && errno == EINTR)
+			continue;
+		if (rc <= 0) {  // closing is up to the reactor thread, it sees the error as well
+			DOLOG(log_ss::LS_COMM, "com_posix_tty cannot write: %s", strerror(errno));
 			break;
 		}
 
@@ -4,14 +4,17 @@
 #include "gen.h"
 #if !defined(_WIN32)
 #include "comm.h"
+#include "comm_reactor.h"
+#include "my_lock.h"
 
 
-class comm_posix_tty: public comm
+class comm_posix_tty: public comm, public comm_reactor_handler
 {
 private:
 	const std::string device;
 	const int         bitrate;
 	int               fd { -1 };
+	mutable my_lock   fd_lock;  // closed by the reactor thread, written to by the device thread
 
 public:
 	comm_posix_tty(const std::string & dev, const int bitrate);
@@ -30,7 +33,12 @@ public:
 
 	bool    has_data() override;
 	uint8_t get_byte() override;
+	size_t  get_bytes(uint8_t *const out, const size_t n) override;
 
 	void    send_data(const uint8_t *const in, const size_t n) override;
+
+	bool    can_notify() const override { return true; }
+
+	void    handle_readable(const int fd) override;
 };
 #endif
@@ -0,0 +1,157 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#if IS_POSIX
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "comm_pty.h"
+#include "log.h"
+
+
+comm_pty::comm_pty(const std::string & link) :
+	link(link)
+{
+}
+
+comm_pty::~comm_pty()
+{
+	comm_reactor::get_instance()->remove_handler(this);
+
+	if (fd != -1)
+		close(fd);
+	if (slave_fd != -1)
+		close(slave_fd);
+
+	if (link.empty() == false)
+		unlink(link.c_str());
+}
+
+bool comm_pty::begin()
+{
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd == -1) {
+		DOLOG(log_ss::LS_COMM, "comm_pty: cannot allocate a pty: %s", strerror(errno));
+		return false;
+	}
+
+	const char *name = nullptr;
+	if (grantpt(fd) == -1 || unlockpt(fd) == -1 || (name = ptsname(fd)) == nullptr) {
+		DOLOG(log_ss::LS_COMM, "comm_pty: cannot setup pty: %s", strerror(errno));
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	slave_name = name;
+
+	// when nobody reads the other side, output is dropped instead of blocking the emulation
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	slave_fd = open(slave_name.c_str(), O_RDWR | O_NOCTTY);
+	if (slave_fd == -1) {
+		DOLOG(log_ss::LS_COMM, "comm_pty: cannot open %s: %s", slave_name.c_str(), strerror(errno));
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	// the guest does echo, line editing, etc.
+	termios tty { };
+	if (tcgetattr(slave_fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		tcsetattr(slave_fd, TCSANOW, &tty);
+	}
+
+	if (link.empty() == false) {
+		unlink(link.c_str());  // left behind by a previous run
+
+		if (symlink(slave_name.c_str(), link.c_str()) == -1)
+			DOLOG(log_ss::LS_COMM, "comm_pty: cannot create symlink %s: %s", link.c_str(), strerror(errno));
+	}
+
+	DOLOG(log_ss::LS_COMM, "comm_pty: %s", get_identifier().c_str());
+
+	return comm_reactor::get_instance()->add(fd, this);
+}
+
+// there's no way to see if a user has it open
+bool comm_pty::is_connected()
+{
+	return fd != -1 && failed == false;
+}
+
+bool comm_pty::has_data()
+{
+	return rx_has_data();
+}
+
+uint8_t comm_pty::get_byte()
+{
+	return rx_get_byte();
+}
+
+size_t comm_pty::get_bytes(uint8_t *const out, const size_t n)
+{
+	return rx_read(out, n);
+}
+
+void comm_pty::handle_readable(const int ready_fd)
+{
+	if (receive(ready_fd) == false) {
+		DOLOG(log_ss::LS_COMM, "comm_pty: cannot read from %s", slave_name.c_str());
+		comm_reactor::get_instance()->remove(ready_fd);
+		failed = true;  // closing is left to the destructor: send_data() may be using fd
+	}
+
+	notify();
+}
+
+void comm_pty::send_data(const uint8_t *const in, const size_t n)
+{
+	const uint8_t *p   = in;
+	size_t         len = n;
+
+	if (is_connected() == false)
+		return;
+
+	while(len > 0) {
+		int rc = write(fd, p, len);
+		if (rc <= 0) {
+			if (rc == -1 && errno == EINTR)
+				continue;
+
+			if (rc == -1 && errno == EAGAIN) {
+				DOLOG(log_ss::LS_COMM, "comm_pty: %s is full, %" PRIzu " bytes dropped", slave_name.c_str(), len);
+				break;
+			}
+
+			DOLOG(log_ss::LS_COMM, "comm_pty: cannot write to %s: %s", slave_name.c_str(), strerror(errno));
+			break;
+		}
+
+		p   += rc;
+		len -= rc;
+	}
+}
+
+JsonDocument comm_pty::serialize() const
+{
+	JsonDocument j;
+
+	j["comm-backend-type"] = "pty";
+	j["link"] = link;
+
+	return j;
+}
+
+comm_pty *comm_pty::deserialize(const JsonVariantConst j)
+{
+	return new comm_pty(j["link"].as<std::string>());
+}
+#endif
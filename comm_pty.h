@@ -0,0 +1,46 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#if IS_POSIX
+#include <string>
+
+#include "comm.h"
+#include "comm_reactor.h"
+
+
+// a pseudo terminal: e.g. 'screen /dev/pts/x' or 'cu' can attach to it. when
+// 'link' is not empty, a symlink with that name points to the slave device.
+class comm_pty: public comm, public comm_reactor_handler
+{
+private:
+	const std::string link;
+	std::string       slave_name;
+	int               fd       { -1 };  // master, only closed by the destructor
+	int               slave_fd { -1 };  // kept open so that the master does not hang up when a user detaches
+	abool             failed   { false };  // reading failed, the reactor no longer watches fd
+
+public:
+	comm_pty(const std::string & link);
+	virtual ~comm_pty();
+
+	bool    begin() override;
+
+	JsonDocument serialize() const override;
+	static comm_pty *deserialize(const JsonVariantConst j);
+
+	std::string get_identifier() const override { return (link.empty() ? slave_name : link + " -> " + slave_name) + " (pty)"; }
+
+	bool    is_connected() override;
+
+	bool    has_data() override;
+	uint8_t get_byte() override;
+	size_t  get_bytes(uint8_t *const out, const size_t n) override;
+
+	void    send_data(const uint8_t *const in, const size_t n) override;
+
+	bool    can_notify() const override { return true; }
+
+	void    handle_readable(const int fd) override;
+};
+#endif
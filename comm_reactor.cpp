@@ -0,0 +1,317 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#if IS_POSIX
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <vector>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+#include "comm_reactor.h"
+#include "log.h"
+#include "utils.h"
+
+
+constexpr const int retry_interval_ms = 100;
+
+comm_reactor_handler::comm_reactor_handler()
+{
+}
+
+comm_reactor_handler::~comm_reactor_handler()
+{
+}
+
+bool comm_reactor_handler::receive(const int fd)
+{
+	uint8_t buffer[4096];
+
+	size_t space = std::min(sizeof buffer, rx_ring.get_free());
+	if (space == 0) {
+		comm_reactor::get_instance()->set_paused(fd, true);
+		rx_paused_fd = fd;
+
+		// the consumer may have emptied the ring before it could see 'rx_paused_fd'
+		if (rx_ring.get_free() > 0 && rx_paused_fd.exchange(-1) == fd)
+			comm_reactor::get_instance()->set_paused(fd, false);
+
+		return true;
+	}
+
+	int rc = read(fd, buffer, space);
+	if (rc <= 0) {
+		if (rc == -1 && (errno == EAGAIN || errno == EINTR))
+			return true;
+
+		return false;
+	}
+
+	rx_ring.write(buffer, rc);
+
+	return true;
+}
+
+uint8_t comm_reactor_handler::rx_get_byte()
+{
+	uint8_t c = 0;
+	rx_read(&c, 1);
+
+	return c;
+}
+
+size_t comm_reactor_handler::rx_read(uint8_t *const out, const size_t n)
+{
+	size_t rc = rx_ring.read(out, n);
+
+	int fd = rx_paused_fd.exchange(-1);
+	if (fd != -1)
+		comm_reactor::get_instance()->set_paused(fd, false);
+
+	return rc;
+}
+
+comm_reactor::comm_reactor()
+{
+	if (pipe(wake_fds) == -1)
+		DOLOG(log_ss::LS_COMM, "comm_reactor: cannot create pipe: %s", strerror(errno));
+	else
+		fcntl(wake_fds[0], F_SETFL, O_NONBLOCK);
+
+#if defined(__linux__)
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1)
+		DOLOG(log_ss::LS_COMM, "comm_reactor: epoll_create1 failed: %s", strerror(errno));
+
+	epoll_event ev { };
+	ev.events  = EPOLLIN;
+	ev.data.fd = wake_fds[0];
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fds[0], &ev);
+#endif
+
+	th = new std::thread(std::ref(*this));
+}
+
+comm_reactor::~comm_reactor()
+{
+	stop_flag = true;
+	wake_up();
+
+	th->join();
+	delete th;
+
+#if defined(__linux__)
+	close(epoll_fd);
+#endif
+	close(wake_fds[0]);
+	close(wake_fds[1]);
+}
+
+comm_reactor *comm_reactor::get_instance()
+{
+	static comm_reactor instance;
+
+	return &instance;
+}
+
+void comm_reactor::wake_up()
+{
+	uint8_t c = 0;
+	if (write(wake_fds[1], &c, 1) == -1)
+		DOLOG(log_ss::LS_COMM, "comm_reactor: cannot wake up thread: %s", strerror(errno));
+}
+
+bool comm_reactor::add(const int fd, comm_reactor_handler *const h)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	handlers[fd] = h;
+
+#if defined(__linux__)
+	epoll_event ev { };
+	ev.events  = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		DOLOG(log_ss::LS_COMM, "comm_reactor: cannot watch fd %d: %s", fd, strerror(errno));
+		handlers.erase(fd);
+		return false;
+	}
+#else
+	wake_up();  // poll() needs to be restarted with the new set
+#endif
+
+	return true;
+}
+
+void comm_reactor::remove(const int fd)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	if (handlers.erase(fd) == 0)
+		return;
+#if !defined(__linux__)
+	paused.erase(fd);
+#endif
+
+#if defined(__linux__)
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#else
+	wake_up();
+#endif
+}
+
+void comm_reactor::remove_handler(comm_reactor_handler *const h)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	retry.erase(h);
+
+	for(auto it = handlers.begin(); it != handlers.end();) {
+		if (it->second == h) {
+#if defined(__linux__)
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+#else
+			paused.erase(it->first);
+#endif
+			it = handlers.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+#if !defined(__linux__)
+	wake_up();
+#endif
+}
+
+void comm_reactor::set_retry(comm_reactor_handler *const h, const bool state)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	if (state) {
+		if (retry.insert(h).second)
+			wake_up();  // the wait may have been without timeout
+	}
+	else {
+		retry.erase(h);
+	}
+}
+
+void comm_reactor::set_paused(const int fd, const bool state)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	if (handlers.find(fd) == handlers.end())  // e.g. disconnected in the mean time
+		return;
+
+#if defined(__linux__)
+	epoll_event ev { };
+	ev.events  = state ? 0 : uint32_t(EPOLLIN);
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1)
+		DOLOG(log_ss::LS_COMM, "comm_reactor: cannot change fd %d: %s", fd, strerror(errno));
+#else
+	if (state)
+		paused.insert(fd);
+	else
+		paused.erase(fd);
+
+	wake_up();
+#endif
+}
+
+void comm_reactor::dispatch(const int fd)
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	auto it = handlers.find(fd);
+	if (it != handlers.end())  // may have been removed in the mean time
+		it->second->handle_readable(fd);
+}
+
+void comm_reactor::invoke_retries()
+{
+	std::unique_lock<std::recursive_mutex> lck(lock);
+
+	// a handler may take itself out of the set
+	std::vector<comm_reactor_handler *> work(retry.begin(), retry.end());
+
+	for(auto h: work) {
+		if (retry.find(h) != retry.end())
+			h->handle_retry();
+	}
+}
+
+void comm_reactor::operator()()
+{
+	set_thread_name("kek:COMMREACT");
+
+	DOLOG(log_ss::LS_COMM, "comm reactor thread started");
+
+	uint64_t last_retry = 0;
+
+	while(!stop_flag) {
+		int timeout = -1;  // only wake up for events when nothing needs to be retried
+		{
+			std::unique_lock<std::recursive_mutex> lck(lock);
+			if (retry.empty() == false)
+				timeout = retry_interval_ms;
+		}
+
+		std::vector<int> ready;
+
+#if defined(__linux__)
+		epoll_event events[16];
+		int rc = epoll_wait(epoll_fd, events, 16, timeout);
+
+		for(int i=0; i<rc; i++)
+			ready.push_back(events[i].data.fd);
+#else
+		std::vector<pollfd> fds { { wake_fds[0], POLLIN, 0 } };
+		{
+			std::unique_lock<std::recursive_mutex> lck(lock);
+			for(auto & h: handlers) {
+				if (paused.find(h.first) == paused.end())
+					fds.push_back({ h.first, POLLIN, 0 });
+			}
+		}
+
+		int rc = poll(fds.data(), fds.size(), timeout);
+
+		for(size_t i=0; rc > 0 && i<fds.size(); i++) {
+			if (fds[i].revents)
+				ready.push_back(fds[i].fd);
+		}
+#endif
+		if (rc == -1 && errno != EINTR) {
+			DOLOG(log_ss::LS_COMM, "comm_reactor: wait failed: %s", strerror(errno));
+			break;
+		}
+
+		for(int fd: ready) {
+			if (fd == wake_fds[0]) {
+				uint8_t buffer[16];
+				while(read(wake_fds[0], buffer, sizeof buffer) > 0) {
+				}
+			}
+			else {
+				dispatch(fd);
+			}
+		}
+
+		if (timeout != -1 && get_ms() - last_retry >= retry_interval_ms) {
+			last_retry = get_ms();
+			invoke_retries();
+		}
+	}
+
+	DOLOG(log_ss::LS_COMM, "comm reactor thread terminating");
+}
+#endif
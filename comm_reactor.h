@@ -0,0 +1,86 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#if IS_POSIX
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+#include "spsc_ring.h"
+
+
+constexpr const size_t comm_rx_ring_size = 65536;
+
+// a comm backend whose file descriptors are watched by the comm_reactor.
+// received data goes from the reactor thread to the device emulation via a
+// ring buffer without locking. when that ring is full, the fd is no longer
+// watched until the device has read from it: the sender then gets pushback
+// from tcp.
+class comm_reactor_handler
+{
+private:
+	spsc_ring<comm_rx_ring_size> rx_ring;
+	std::atomic_int     rx_paused_fd { -1 };
+
+protected:
+	// reads what is available on 'fd' into 'rx_ring', false on EOF/error
+	bool    receive(const int fd);
+	bool    rx_has_data() const { return rx_ring.is_empty() == false; }
+	uint8_t rx_get_byte();
+	size_t  rx_read(uint8_t *const out, const size_t n);
+
+public:
+	comm_reactor_handler();
+	virtual ~comm_reactor_handler();
+
+	// invoked by the reactor thread
+	virtual void handle_readable(const int fd) = 0;
+	virtual void handle_retry() { }  // periodically, while set_retry() is on
+};
+
+// one thread for the whole process that waits for all comm sockets and ttys
+// (epoll on Linux, poll elsewhere) instead of a polling thread per channel.
+// handlers are invoked with 'lock' held: after remove() or set_retry(false)
+// returns, a handler is not invoked anymore and can be deleted.
+class comm_reactor
+{
+private:
+	std::recursive_mutex lock;
+	std::unordered_map<int, comm_reactor_handler *> handlers;
+	std::set<comm_reactor_handler *> retry;
+#if !defined(__linux__)
+	std::set<int>        paused;
+#endif
+	int                  wake_fds[2] { -1, -1 };  // pipe to interrupt the wait
+#if defined(__linux__)
+	int                  epoll_fd    { -1 };
+#endif
+	std::atomic_bool     stop_flag   { false   };
+	std::thread         *th          { nullptr };
+
+	comm_reactor();
+
+	void wake_up();
+	void dispatch(const int fd);
+	void invoke_retries();
+
+public:
+	~comm_reactor();
+
+	static comm_reactor *get_instance();
+
+	bool add      (const int fd, comm_reactor_handler *const h);
+	void remove   (const int fd);
+	void remove_handler(comm_reactor_handler *const h);  // all its fds + retry
+	void set_retry(comm_reactor_handler *const h, const bool state);
+	void set_paused(const int fd, const bool state);  // stop/resume watching
+
+	void operator()();
+};
+#endif
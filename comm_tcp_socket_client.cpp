@@ -33,6 +33,11 @@
 #include "log.h"
 #include "utils.h"
 
+#if IS_POSIX
+constexpr const int resolve_retry_ms   =  1000;  // after a failed lookup
+constexpr const int resolve_refresh_ms = 30000;  // the address of the host may change
+#endif
+
 
 comm_tcp_socket_client::comm_tcp_socket_client(const std::string & host, const int port) :
 	host(host),
@@ -44,15 +49,32 @@ comm_tcp_socket_client::~comm_tcp_socket_client()
 {
 	stop_flag = true;
 
+#if IS_POSIX
+	comm_reactor::get_instance()->remove_handler(this);
+
+	if (resolver) {
+		resolver->join();
+		delete resolver;
+	}
+
+	if (cfd != INVALID_SOCKET)
+		closesocket(cfd);
+#else
 	if (th) {
 		th->join();
 		delete th;
 	}
+#endif
 }
 
 bool comm_tcp_socket_client::begin()
 {
+#if IS_POSIX
+	// connecting is done by the reactor thread
+	comm_reactor::get_instance()->set_retry(this, true);
+#else
 	th = new std::thread(std::ref(*this));
+#endif
 
 	return true;
 }
@@ -60,10 +82,29 @@ bool comm_tcp_socket_client::begin()
 bool comm_tcp_socket_client::is_connected()
 {
 	my_unique_lock lck(&cfd_lock);
-
+#if IS_POSIX
+	return cfd != INVALID_SOCKET && connecting == false;
+#else
 	return cfd != INVALID_SOCKET;
+#endif
+}
+
+#if IS_POSIX
+bool comm_tcp_socket_client::has_data()
+{
+	return rx_has_data();
 }
 
+uint8_t comm_tcp_socket_client::get_byte()
+{
+	return rx_get_byte();
+}
+
+size_t comm_tcp_socket_client::get_bytes(uint8_t *const out, const size_t n)
+{
+	return rx_read(out, n);
+}
+#else
 bool comm_tcp_socket_client::has_data()
 {
 	my_unique_lock lck(&cfd_lock);
@@ -74,7 +115,6 @@ bool comm_tcp_socket_client::has_data()
 	pollfd    fds[] { { cfd, POLLIN, 0 } };
 	int rc = poll(fds, 1, 0);
 #endif
-
 	return rc == 1;
 }
 
@@ -106,6 +146,7 @@ uint8_t comm_tcp_socket_client::get_byte()
 
 	return c;
 }
+#endif
 
 void comm_tcp_socket_client::send_data(const uint8_t *const in, const size_t n)
 {
@@ -122,6 +163,16 @@ void comm_tcp_socket_client::send_data(const uint8_t *const in, const size_t n)
 			cfd = INVALID_SOCKET;
 			break;
 		}
+#elif IS_POSIX
+		if (cfd == INVALID_SOCKET || connecting)
+			break;
+
+		int rc = write(cfd, p, len);
+		if (rc <= 0) {
+			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client::send_data: failed");
+			shutdown(cfd, SHUT_RDWR);  // the reactor thread sees the EOF and reconnects
+			break;
+		}
 #else
 		int rc = write(cfd, p, len);
 		if (rc <= 0) {
@@ -131,12 +182,177 @@ void comm_tcp_socket_client::send_data(const uint8_t *const in, const size_t n)
 			break;
 		}
 #endif
-
 		p   += rc;
 		len -= rc;
 	}
 }
 
+#if IS_POSIX
+// runs in the 'resolver' thread
+void comm_tcp_socket_client::resolve()
+{
+	addrinfo *res     = nullptr;
+	addrinfo hints { };
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	char port_str[8] { 0 };
+	snprintf(port_str, sizeof port_str, "%u", port);
+
+	std::vector<address> out;
+
+	int rc = getaddrinfo(host.c_str(), port_str, &hints, &res);
+	if (rc != 0)
+		DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: cannot resolve \"%s\":%s: %s", host.c_str(), port_str, gai_strerror(rc));
+	else {
+		for(addrinfo *p = res; p != NULL; p = p->ai_next) {
+			address a { };
+			memcpy(&a.addr, p->ai_addr, p->ai_addrlen);
+			a.len      = p->ai_addrlen;
+			a.family   = p->ai_family;
+			a.protocol = p->ai_protocol;
+			out.push_back(a);
+		}
+
+		freeaddrinfo(res);
+	}
+
+	my_unique_lock lck(&resolve_lock);
+	if (out.empty() == false)  // else keep what was found before, if anything
+		addresses = std::move(out);
+	resolved_at = get_ms();
+	resolving   = false;
+}
+
+// starts a lookup when there's no (recent) result, false if there's nothing
+// to connect to yet
+bool comm_tcp_socket_client::get_addresses(std::vector<address> *const out)
+{
+	my_unique_lock lck(&resolve_lock);
+
+	if (resolving == false && stop_flag == false && get_ms() - resolved_at >= uint64_t(addresses.empty() ? resolve_retry_ms : resolve_refresh_ms)) {
+		if (resolver) {  // has finished
+			resolver->join();
+			delete resolver;
+		}
+
+		resolving = true;
+		resolver  = new std::thread(&comm_tcp_socket_client::resolve, this);
+	}
+
+	*out = addresses;
+
+	return out->empty() == false;
+}
+
+// invoked with cfd_lock held
+void comm_tcp_socket_client::start_connect(const std::vector<address> & targets)
+{
+	for(auto & a: targets) {
+		if ((cfd = socket(a.family, SOCK_STREAM, a.protocol)) == -1)
+			continue;
+
+		// the reactor thread must not block on an unreachable host
+		fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+
+		if (::connect(cfd, reinterpret_cast<const sockaddr *>(&a.addr), a.len) == 0 || errno == EINPROGRESS) {
+			connecting    = true;
+			connect_start = get_ms();
+			break;
+		}
+
+		closesocket(cfd);
+		cfd = INVALID_SOCKET;
+		DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: cannot connect");
+	}
+
+	if (cfd != INVALID_SOCKET)
+		check_connect();
+}
+
+// invoked with cfd_lock held
+void comm_tcp_socket_client::check_connect()
+{
+	pollfd fds[] { { cfd, POLLOUT, 0 } };
+	if (poll(fds, 1, 0) == 0) {
+		if (get_ms() - connect_start < 5000)  // still in progress
+			return;
+
+		DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: timeout connecting to %s:%d", host.c_str(), port);
+	}
+	else {
+		int       err     = 0;
+		socklen_t err_len = sizeof err;
+		if (getsockopt(cfd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0) {
+			fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) & ~O_NONBLOCK);
+			set_nodelay(cfd);
+
+			connecting = false;
+
+			comm_reactor *r = comm_reactor::get_instance();
+			r->add(cfd, this);
+			r->set_retry(this, false);
+
+			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: connected to %s:%d", host.c_str(), port);
+			notify();
+			return;
+		}
+
+		DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: cannot connect to %s:%d: %s", host.c_str(), port, strerror(err));
+	}
+
+	closesocket(cfd);
+	cfd        = INVALID_SOCKET;
+	connecting = false;
+}
+
+void comm_tcp_socket_client::handle_retry()
+{
+	{
+		my_unique_lock lck(&cfd_lock);
+
+		if (connecting) {
+			check_connect();
+			return;
+		}
+
+		if (cfd != INVALID_SOCKET)
+			return;
+	}
+
+	// not with cfd_lock held: send_data() must not wait for a lookup
+	std::vector<address> targets;
+	if (get_addresses(&targets) == false)
+		return;
+
+	my_unique_lock lck(&cfd_lock);
+	if (cfd == INVALID_SOCKET)
+		start_connect(targets);
+}
+
+void comm_tcp_socket_client::handle_readable(const int fd)
+{
+	if (receive(fd)) {
+		notify();
+		return;
+	}
+
+	DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client: connection to %s:%d lost", host.c_str(), port);
+
+	comm_reactor *r = comm_reactor::get_instance();
+	r->remove(fd);
+
+	my_unique_lock lck(&cfd_lock);
+	if (cfd == fd) {
+		closesocket(cfd);
+		cfd = INVALID_SOCKET;
+	}
+
+	r->set_retry(this, true);
+
+	notify();
+}
+#else
 void comm_tcp_socket_client::operator()()
 {
 	set_thread_name("kek:COMMTCPC");
@@ -193,6 +409,7 @@ void comm_tcp_socket_client::operator()()
 
 	closesocket(cfd);
 }
+#endif
 
 #if IS_POSIX
 JsonDocument comm_tcp_socket_client::serialize() const
@@ -8,8 +8,10 @@
 #endif
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "comm.h"
+#include "comm_reactor.h"
 #include "my_lock.h"
 #include "utils.h"
 
@@ -17,12 +19,19 @@
 #include <ws2tcpip.h>
 #include <winsock2.h>
 #else
+#if IS_POSIX
+#include <sys/socket.h>
+#endif
 #define SOCKET int
 #define INVALID_SOCKET -1
 #endif
 
 
+#if IS_POSIX
+class comm_tcp_socket_client: public comm, public comm_reactor_handler
+#else
 class comm_tcp_socket_client: public comm
+#endif
 {
 private:
 	const std::string host;
@@ -30,7 +39,31 @@ private:
 	std::atomic_bool  stop_flag { false          };
 	SOCKET            cfd       { INVALID_SOCKET };
         my_lock           cfd_lock;
+#if IS_POSIX
+	bool              connecting    { false      };  // non-blocking connect() in progress
+	uint64_t          connect_start { 0          };
+
+	// getaddrinfo() can block for a long time: it runs in its own thread
+	// so that the reactor thread (and so all comm channels) never waits
+	struct address {
+		sockaddr_storage addr;
+		socklen_t        len;
+		int              family;
+		int              protocol;
+	};
+	std::thread      *resolver      { nullptr    };
+	my_lock           resolve_lock;
+	std::vector<address> addresses;  // result of the last lookup
+	bool              resolving     { false      };
+	uint64_t          resolved_at   { 0          };
+
+	void    resolve();
+	bool    get_addresses(std::vector<address> *const out);
+	void    start_connect(const std::vector<address> & targets);
+	void    check_connect();
+#else
 	std::thread      *th        { nullptr        };
+#endif
 
 public:
 	comm_tcp_socket_client(const std::string & host, const int port);
@@ -49,8 +82,18 @@ public:
 
 	bool    has_data() override;
 	uint8_t get_byte() override;
+#if IS_POSIX
+	size_t  get_bytes(uint8_t *const out, const size_t n) override;
+#endif
 
 	void    send_data(const uint8_t *const in, const size_t n) override;
 
+#if IS_POSIX
+	bool    can_notify() const override { return true; }
+
+	void    handle_readable(const int fd) override;
+	void    handle_retry() override;
+#else
 	void    operator()();
+#endif
 };
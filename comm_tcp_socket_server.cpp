@@ -66,10 +66,14 @@ comm_tcp_socket_server::~comm_tcp_socket_server()
 {
 	stop_flag = true;
 
+#if IS_POSIX
+	comm_reactor::get_instance()->remove_handler(this);
+#else
 	if (th) {
 		th->join();
 		delete th;
 	}
+#endif
 
 	if (fd != INVALID_SOCKET)
 		closesocket(fd);
@@ -81,9 +85,16 @@ comm_tcp_socket_server::~comm_tcp_socket_server()
 
 bool comm_tcp_socket_server::begin()
 {
+#if IS_POSIX
+	if (setup_listener() == false)
+		return false;
+
+	return comm_reactor::get_instance()->add(fd, this);
+#else
 	th = new std::thread(std::ref(*this));
 
 	return true;
+#endif
 }
 
 bool comm_tcp_socket_server::is_connected()
@@ -92,6 +103,22 @@ bool comm_tcp_socket_server::is_connected()
 	return cfd != INVALID_SOCKET;
 }
 
+#if IS_POSIX
+bool comm_tcp_socket_server::has_data()
+{
+	return rx_has_data();
+}
+
+uint8_t comm_tcp_socket_server::get_byte()
+{
+	return rx_get_byte();
+}
+
+size_t comm_tcp_socket_server::get_bytes(uint8_t *const out, const size_t n)
+{
+	return rx_read(out, n);
+}
+#else
 bool comm_tcp_socket_server::has_data()
 {
 	if (cfd == -1)
@@ -152,37 +179,42 @@ uint8_t comm_tcp_socket_server::get_byte()
 
 	return c;
 }
+#endif
 
 void comm_tcp_socket_server::send_data(const uint8_t *const in, const size_t n)
 {
-	if (cfd == -1)  // not connected
-		return;
-
 	const uint8_t *p   = in;
 	size_t         len = n;
 
+	// held while writing so that the session cannot be closed (and the
+	// number cannot be reused) meanwhile
+	my_unique_lock lck(&cfd_lock);
+	if (cfd == INVALID_SOCKET)  // not connected
+		return;
+
 	while(len > 0) {
-		int use_fd = -1;
-		{
-			my_unique_lock lck(&cfd_lock);
-			use_fd = cfd;
-		}
 #if defined(_WIN32)
-		int rc = send(use_fd, reinterpret_cast<const char *>(p), len, 0);
+		int rc = send(cfd, reinterpret_cast<const char *>(p), len, 0);
 		if (rc <= 0) {
-			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client::send_data: failed");
-			my_unique_lock lck(&cfd_lock);
+			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_server::send_data: failed");
 			closesocket(cfd);
 			cfd = INVALID_SOCKET;
 			break;
 		}
 #else
-		int rc = write(use_fd, p, len);
+		int rc = write(cfd, p, len);
+#if IS_POSIX
+		if (rc == -1 && errno == EINTR)
+			continue;
+#endif
 		if (rc <= 0) {
-			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_client::send_data: failed");
-			my_unique_lock lck(&cfd_lock);
+			DOLOG(log_ss::LS_COMM, "comm_tcp_socket_server::send_data: failed");
+#if IS_POSIX
+			shutdown(cfd, SHUT_RDWR);  // the reactor thread sees the EOF and closes it
+#else
 			close(cfd);
 			cfd = INVALID_SOCKET;
+#endif
 			break;
 		}
 #endif
@@ -191,12 +223,8 @@ void comm_tcp_socket_server::send_data(const uint8_t *const in, const size_t n)
 	}
 }
 
-void comm_tcp_socket_server::operator()()
+bool comm_tcp_socket_server::setup_listener()
 {
-	set_thread_name("kek:COMMTCPS");
-
-	DOLOG(log_ss::LS_COMM, "TCP comm thread started for port %d", port);
-
 	fd = socket(AF_INET, SOCK_STREAM, 0);
 
 #if !defined(_WIN32)
@@ -206,7 +234,7 @@ void comm_tcp_socket_server::operator()()
 		fd = INVALID_SOCKET;
 
 		DOLOG(log_ss::LS_COMM, "Cannot set reuseaddress for port %d (comm_tcp_socket_server)", port);
-		return;
+		return false;
 	}
 #endif
 	set_nodelay(fd);
@@ -222,7 +250,7 @@ void comm_tcp_socket_server::operator()()
 
 		closesocket(fd);
 		fd = INVALID_SOCKET;
-		return;
+		return false;
 	}
 
 	if (listen(fd, SOMAXCONN) == -1) {
@@ -230,9 +258,75 @@ void comm_tcp_socket_server::operator()()
 		fd = INVALID_SOCKET;
 
 		DOLOG(log_ss::LS_COMM, "Cannot listen on port %d (comm_tcp_socket_server)", port);
+		return false;
+	}
+
+	return true;
+}
+
+#if IS_POSIX
+void comm_tcp_socket_server::accept_session()
+{
+	comm_reactor *r = comm_reactor::get_instance();
+
+	{
+		my_unique_lock lck(&cfd_lock);
+		// disconnect any existing client session
+		// yes, one can 'DOS' with this
+		if (cfd != INVALID_SOCKET) {
+			r->remove(cfd);
+			closesocket(cfd);
+			cfd = INVALID_SOCKET;
+			DOLOG(log_ss::LS_COMM, "Restarting session for port %d", port);
+		}
+	}
+
+	int temp = accept(fd, nullptr, nullptr);
+	if (temp == INVALID_SOCKET)
 		return;
+
+	set_nodelay(temp);
+	DOLOG(log_ss::LS_COMM, "Connected with %s", get_endpoint_name(temp).c_str());
+
+	{
+		my_unique_lock lck(&cfd_lock);
+		cfd = temp;
+	}
+
+	r->add(temp, this);
+
+	if (setup_telnet)
+		setup_telnet_session();
+}
+
+void comm_tcp_socket_server::handle_readable(const int ready_fd)
+{
+	if (ready_fd == fd)
+		accept_session();
+	else if (receive(ready_fd) == false) {
+		DOLOG(log_ss::LS_COMM, "comm_tcp_socket_server: session on port %d ended", port);
+
+		comm_reactor::get_instance()->remove(ready_fd);
+
+		my_unique_lock lck(&cfd_lock);
+		if (cfd == ready_fd) {
+			closesocket(cfd);
+			cfd = INVALID_SOCKET;
+		}
 	}
 
+	notify();
+}
+#else
+void comm_tcp_socket_server::operator()()
+{
+	set_thread_name("kek:COMMTCPS");
+
+	DOLOG(log_ss::LS_COMM, "TCP comm thread started for port %d", port);
+
+	if (setup_listener() == false)
+		return;
+
 #if defined(_WIN32)
 	WSAPOLLFD fds[] { { fd, POLLIN, 0 } };
 #else
@@ -274,6 +368,7 @@ void comm_tcp_socket_server::operator()()
 
 	DOLOG(log_ss::LS_COMM, "comm_tcp_socket_server thread terminating");
 }
+#endif
 
 #if IS_POSIX
 JsonDocument comm_tcp_socket_server::serialize() const
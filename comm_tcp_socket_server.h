@@ -7,6 +7,7 @@
 #include <thread>
 
 #include "comm.h"
+#include "comm_reactor.h"
 #include "my_lock.h"
 #include "utils.h"
 
@@ -19,7 +20,11 @@
 #endif
 
 
+#if IS_POSIX
+class comm_tcp_socket_server: public comm, public comm_reactor_handler
+#else
 class comm_tcp_socket_server: public comm
+#endif
 {
 private:
 	const int        port      { -1             };
@@ -28,9 +33,15 @@ private:
 	SOCKET           fd        { INVALID_SOCKET };
 	SOCKET           cfd       { INVALID_SOCKET };
         my_lock          cfd_lock;
+#if !IS_POSIX
 	std::thread     *th        { nullptr        };
+#endif
 
 	void setup_telnet_session();
+	bool setup_listener();
+#if IS_POSIX
+	void accept_session();
+#endif
 
 public:
 	comm_tcp_socket_server(const int port, const bool setup_telnet);
@@ -49,8 +60,17 @@ public:
 
 	bool    has_data() override;
 	uint8_t get_byte() override;
+#if IS_POSIX
+	size_t  get_bytes(uint8_t *const out, const size_t n) override;
+#endif
 
 	void    send_data(const uint8_t *const in, const size_t n) override;
 
+#if IS_POSIX
+	bool    can_notify() const override { return true; }
+
+	void    handle_readable(const int fd) override;
+#else
 	void    operator()();
+#endif
 };
@@ -0,0 +1,195 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#if IS_POSIX
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "comm_unix_socket.h"
+#include "log.h"
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+
+comm_unix_socket::comm_unix_socket(const std::string & path) :
+	path(path)
+{
+}
+
+comm_unix_socket::~comm_unix_socket()
+{
+	comm_reactor::get_instance()->remove_handler(this);
+
+	if (fd != -1) {
+		close(fd);
+		unlink(path.c_str());
+	}
+	if (cfd != -1)
+		close(cfd);
+
+	DOLOG(log_ss::LS_COMM, "destructor for unix socket %s finished", path.c_str());
+}
+
+bool comm_unix_socket::begin()
+{
+	if (setup_listener() == false)
+		return false;
+
+	return comm_reactor::get_instance()->add(fd, this);
+}
+
+bool comm_unix_socket::setup_listener()
+{
+	sockaddr_un addr { };
+	if (path.size() >= sizeof addr.sun_path) {
+		DOLOG(log_ss::LS_COMM, "Unix socket path %s is too long", path.c_str());
+		return false;
+	}
+
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		DOLOG(log_ss::LS_COMM, "Cannot create unix socket: %s", strerror(errno));
+		return false;
+	}
+
+	unlink(path.c_str());  // left behind by a previous run
+
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == -1) {
+		DOLOG(log_ss::LS_COMM, "Cannot bind to unix socket %s: %s", path.c_str(), strerror(errno));
+
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	if (listen(fd, SOMAXCONN) == -1) {
+		DOLOG(log_ss::LS_COMM, "Cannot listen on unix socket %s: %s", path.c_str(), strerror(errno));
+
+		close(fd);
+		fd = -1;
+		unlink(path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void comm_unix_socket::accept_session()
+{
+	comm_reactor *r = comm_reactor::get_instance();
+
+	{
+		my_unique_lock lck(&cfd_lock);
+		// disconnect any existing client session
+		if (cfd != -1) {
+			r->remove(cfd);
+			close(cfd);
+			cfd = -1;
+			DOLOG(log_ss::LS_COMM, "Restarting session for %s", path.c_str());
+		}
+	}
+
+	int temp = accept(fd, nullptr, nullptr);
+	if (temp == -1)
+		return;
+
+	DOLOG(log_ss::LS_COMM, "Connected to %s", path.c_str());
+
+	{
+		my_unique_lock lck(&cfd_lock);
+		cfd = temp;
+	}
+
+	r->add(temp, this);
+}
+
+bool comm_unix_socket::is_connected()
+{
+	my_unique_lock lck(&cfd_lock);
+	return cfd != -1;
+}
+
+bool comm_unix_socket::has_data()
+{
+	return rx_has_data();
+}
+
+uint8_t comm_unix_socket::get_byte()
+{
+	return rx_get_byte();
+}
+
+size_t comm_unix_socket::get_bytes(uint8_t *const out, const size_t n)
+{
+	return rx_read(out, n);
+}
+
+void comm_unix_socket::handle_readable(const int ready_fd)
+{
+	if (ready_fd == fd)
+		accept_session();
+	else if (receive(ready_fd) == false) {
+		DOLOG(log_ss::LS_COMM, "comm_unix_socket: session on %s ended", path.c_str());
+
+		comm_reactor::get_instance()->remove(ready_fd);
+
+		my_unique_lock lck(&cfd_lock);
+		if (cfd == ready_fd) {
+			close(cfd);
+			cfd = -1;
+		}
+	}
+
+	notify();
+}
+
+void comm_unix_socket::send_data(const uint8_t *const in, const size_t n)
+{
+	const uint8_t *p   = in;
+	size_t         len = n;
+
+	// held while writing so that the reactor thread cannot close (and the
+	// number cannot be reused) meanwhile
+	my_unique_lock lck(&cfd_lock);
+	if (cfd == -1)  // not connected
+		return;
+
+	while(len > 0) {
+		int rc = send(cfd, p, len, MSG_NOSIGNAL);
+		if (rc == -1 && errno == EINTR)
+			continue;
+		if (rc <= 0) {
+			DOLOG(log_ss::LS_COMM, "comm_unix_socket::send_data: failed");
+			shutdown(cfd, SHUT_RDWR);  // the reactor thread sees the EOF and closes it
+			break;
+		}
+
+		p   += rc;
+		len -= rc;
+	}
+}
+
+JsonDocument comm_unix_socket::serialize() const
+{
+	JsonDocument j;
+
+	j["comm-backend-type"] = "unix-socket";
+	j["path"] = path;
+
+	return j;
+}
+
+comm_unix_socket *comm_unix_socket::deserialize(const JsonVariantConst j)
+{
+	return new comm_unix_socket(j["path"].as<std::string>());
+}
+#endif
@@ -0,0 +1,49 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#if IS_POSIX
+#include <string>
+
+#include "comm.h"
+#include "comm_reactor.h"
+#include "my_lock.h"
+
+
+// listens on a unix domain socket: for local tools (expect, screen via
+// socat, test harnesses) that do not need tcp or telnet negotiation
+class comm_unix_socket: public comm, public comm_reactor_handler
+{
+private:
+	const std::string path;
+	int               fd        { -1 };
+	int               cfd       { -1 };
+        my_lock           cfd_lock;
+
+	bool setup_listener();
+	void accept_session();
+
+public:
+	comm_unix_socket(const std::string & path);
+	virtual ~comm_unix_socket();
+
+	bool    begin() override;
+
+	JsonDocument serialize() const override;
+	static comm_unix_socket *deserialize(const JsonVariantConst j);
+
+	std::string get_identifier() const override { return path + " (unix socket)"; }
+
+	bool    is_connected() override;
+
+	bool    has_data() override;
+	uint8_t get_byte() override;
+	size_t  get_bytes(uint8_t *const out, const size_t n) override;
+
+	void    send_data(const uint8_t *const in, const size_t n) override;
+
+	bool    can_notify() const override { return true; }
+
+	void    handle_readable(const int fd) override;
+};
+#endif
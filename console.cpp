@@ -81,6 +81,15 @@ bool console::poll_char()
 	return input_buffer.is_empty() == false;
 }
 
+std::optional<int> console::try_get_char()
+{
+	uint8_t c = 0;
+	if (input_buffer.read(&c, 1) == 0)
+		return { };
+
+	return c;
+}
+
 int console::get_char()
 {
 	auto c = wait_char(100);
@@ -91,15 +100,27 @@ int console::get_char()
 
 std::optional<int> console::wait_char(const int timeout_ms)
 {
-	auto c = input_buffer.pop(timeout_ms);
-	if (c.has_value() == false)
-		return { };
-	return c.value();
+	// a wake-up can be left over from a character that was taken without
+	// waiting, hence a second try
+	for(int i=0; i<2; i++) {
+		auto c = try_get_char();
+		if (c.has_value())
+			return c;
+
+		bool woken = input_wakeup.pop(timeout_ms).has_value();
+		input_wakeup_pending = false;
+		if (woken == false)
+			break;
+	}
+
+	return try_get_char();
 }
 
 void console::flush_input()
 {
-	input_buffer.clear();
+	uint8_t buffer[64];
+	while(input_buffer.read(buffer, sizeof buffer) > 0) {
+	}
 }
 
 void console::emit_backspace()
@@ -218,9 +239,11 @@ std::string console::read_line(const std::string & prompt, const explode_func_t
 	return edit_lines_hist.at(line_nr);
 }
 
-void console::put_char(const char c)
+void console::put_char(const char c, const bool do_flush)
 {
 	put_char_ll(c);
+	if (do_flush)
+		flush_ll();
 
 	if (c == 0) {
 		// ignore these
@@ -349,7 +372,8 @@ void console::put_string(const std::string & what)
 {
 	my_unique_lock lck(&put_string_lock);
 	for(size_t x=0; x<what.size(); x++)
-		put_char(what.at(x));
+		put_char(what.at(x), false);
+	flush_ll();
 }
 
 void console::operator()()
@@ -371,7 +395,15 @@ void console::operator()()
 		else if (running_flag == false && c == 12)  // ^l
 			refresh_virtual_terminal();
 		else {
-			input_buffer.push(c);
+			uint8_t c_byte = c;
+			if (input_buffer.write(&c_byte, 1) == 0)
+				DOLOG(log_ss::LS_GENERIC, "console: input buffer full, character dropped");
+
+			if (input_wakeup_pending.exchange(true) == false)
+				input_wakeup.push(0);
+
+			// the tty raises the receive interrupt from here, so that
+			// the cpu thread never has to wait for a character
 			if (have_data_cb_notifier)
 				have_data_cb_notifier->notify_rx();
 		}
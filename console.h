@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "my_lock.h"
+#include "spsc_ring.h"
 #include "utils.h"
 
 #if defined(_WIN32)
@@ -29,13 +30,24 @@ class tty;
 
 using explode_func_t = std::optional<std::string> (*)(console *const cnsl, const std::string & current_in);
 
+#if IS_POSIX
+constexpr const size_t console_input_size = 4096;
+#else
+constexpr const size_t console_input_size = 256;
+#endif
+
 class console
 {
 public:
 	enum panel_mode_t { PM_BITS, PM_ADDRESS1, PM_ADDRESS2 };
 
 private:
-	my_threadsafe_queue<char> input_buffer;
+	// from the console thread to whoever reads it (the emulated tty or the
+	// debugger, never both at the same time). the queue is only for waking
+	// up a wait_char()
+	spsc_ring<console_input_size> input_buffer;
+	my_threadsafe_queue<int> input_wakeup;
+	abool                   input_wakeup_pending { false };
 	my_lock                 put_string_lock;
 
 protected:
@@ -79,6 +91,7 @@ protected:
 
 	virtual int  wait_for_char_ll(const int  timeout) = 0;
 	virtual void put_char_ll     (const char c      ) = 0;
+	virtual void flush_ll        (                  ) { }  // for when put_char_ll() buffers
 
 public:
 	console(kek_event_t *const stop_event, const int t_width = 80, const int t_height = 25);
@@ -92,6 +105,7 @@ public:
 	void         stop_thread();
 
 	bool         poll_char();
+	std::optional<int> try_get_char();  // never blocks
 	int          get_char();
 	std::optional<int> wait_char(const int timeout_ms);
 	std::string  read_line(const std::string & prompt, const explode_func_t & ef = nullptr);
@@ -101,7 +115,8 @@ public:
 	void         enable_timestamp(const bool state) { timestamps = state; }
 
 	void         emit_backspace();
-	void         put_char(const char c);
+	void         put_char(const char c, const bool do_flush = true);
+	void         flush_output() { flush_ll(); }
 	void         put_string(const std::string & what);
 	virtual void put_string_lf(const std::string & what) = 0;
 
@@ -46,7 +46,22 @@ int console_comm::wait_for_char_ll(const int timeout)
 
 void console_comm::put_char_ll(const char c)
 {
-	io_port->send_data(reinterpret_cast<const uint8_t *>(&c), 1);
+	my_unique_lock lck(&tx_buffer_lock);
+	tx_buffer.push_back(c);
+
+	if (tx_buffer.size() >= comm_tx_buffer_size) {
+		io_port->send_data(tx_buffer.data(), tx_buffer.size());
+		tx_buffer.clear();
+	}
+}
+
+void console_comm::flush_ll()
+{
+	my_unique_lock lck(&tx_buffer_lock);
+	if (tx_buffer.empty() == false) {
+		io_port->send_data(tx_buffer.data(), tx_buffer.size());
+		tx_buffer.clear();
+	}
 }
 
 void console_comm::put_string_lf(const std::string & what)
@@ -11,9 +11,12 @@ class console_comm : public console
 {
 protected:
 	comm         *const io_port    { nullptr };
+	my_lock       tx_buffer_lock;
+	std::vector<uint8_t> tx_buffer;
 
 	int wait_for_char_ll(const int  timeout) override;
 	void put_char_ll    (const char c      ) override;
+	void flush_ll       (                  ) override;
 
 public:
 	console_comm(kek_event_t *const stop_event, comm *const io_port, const int t_width, const int t_height);
@@ -119,6 +119,10 @@ int console_posix::wait_for_char_ll(const int timeout)
 void console_posix::put_char_ll(const char c)
 {
 	putchar(c);
+}
+
+void console_posix::flush_ll()
+{
 	fflush(nullptr);
 }
 
@@ -23,6 +23,7 @@ private:
 protected:
 	int  wait_for_char_ll(const int  timeout) override;
 	void put_char_ll     (const char c      ) override;
+	void flush_ll        (                  ) override;
 
 public:
 	console_posix(std::atomic_uint32_t *const stop_event);
@@ -2,7 +2,9 @@
 // Released under MIT license
 
 #include "gen.h"
+#include <algorithm>
 #include <assert.h>
+#include <bit>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +12,10 @@
 #include "breakpoint.h"
 #include "bus.h"
 #include "cpu.h"
+#include "event_scheduler.h"
+#include "fp11.h"
+#include "governor.h"
+#include "kw11-l.h"
 #include "log.h"
 #include "utils.h"
 
@@ -20,23 +26,49 @@
 
 constexpr const uint16_t word_mode_mask[2] { 0xffff, 0xff };
 
-cpu::cpu(bus *const b, kek_event_t *const event) : b(b), mmu_(b->getMMU()), event(event)
+cpu::cpu(bus *const b, kek_event_t *const event) : b(b), mmu_(b->getMMU()), fpu(new fp11(this, b)), scheduler(new event_scheduler()), event(event)
 {
 	reset();
-
-#if defined(FREERTOS)
-	xSemaphoreGive(qi_lock);  // initialize
-#endif
 }
 
 cpu::~cpu()
 {
+	delete speed_governor;
+	delete scheduler;
+	delete fpu;
+}
+
+void cpu::set_speed_factor(const std::optional<double> factor)
+{
+	delete speed_governor;
+	speed_governor = factor.has_value() ? new governor(factor.value()) : nullptr;
+
+	// a block loop would be accounted at once
+	set_allow_block_loops(block_loops_wanted);
+}
+
+std::optional<double> cpu::get_speed_factor() const
+{
+	if (speed_governor)
+		return speed_governor->get_speed_factor();
+
+	return { };
+}
+
+void cpu::reset_speed_governor()
+{
+	if (speed_governor)
+		speed_governor->reset();
 }
 
 void cpu::init_interrupt_queue()
 {
-	for(uint8_t level=0; level<8; level++)
-		queued_interrupts[level].clear();
+	for(auto & level: queued_interrupts) {
+		for(auto & word: level)
+			word = 0;
+	}
+
+	pending_levels = 0;
 }
 
 std::optional<std::pair<breakpoint &, const std::string> > cpu::check_breakpoint()
@@ -77,56 +109,37 @@ void cpu::reset()
 {
 	memset(regs0_5, 0x00, sizeof regs0_5);
 	memset(sp,      0x00, sizeof sp     );
-	pc   = 0;
+	memset(regs,    0x00, sizeof regs   );
 	psw  = 0;  // 7 << 5;
-	fpsr = 0;
+	fpu->reset();
 	init_interrupt_queue();
+	event_time_offset    += instructions_executed;
 	instructions_executed = 0;
 	processing_trap_depth = 0;
 	kw11l_counter         = 0;
+	instruction_start     = 0;
+	MMR1_log              = 0;
 }
 
 uint16_t cpu::get_register(const int nr) const
 {
 	assert(nr >= 0 && nr < 8);
-	if (nr < 6) {
-		int set = get_register_set();
-		return regs0_5[set][nr];
-	}
-
-	if (nr == 6)
-		return sp[getPSW_runmode()];
 
-	return pc;
+	return regs[nr];
 }
 
 uint16_t *cpu::get_register_pointer(const int nr)
 {
 	assert(nr >= 0 && nr < 8);
-	if (nr < 6) {
-		int set = get_register_set();
-		return &regs0_5[set][nr];
-	}
 
-	if (nr == 6)
-		return &sp[getPSW_runmode()];
-
-	return &pc;
+	return &regs[nr];
 }
 
 void cpu::set_register(const int nr, const uint16_t value)
 {
 	assert(nr >= 0 && nr < 8);
-	if (nr < 6) {
-		int set = get_register_set();
 
-		regs0_5[set][nr] = value;
-	}
-	else if (nr == 6)
-		sp[getPSW_runmode()] = value;
-	else {
-		pc = value;
-	}
+	regs[nr] = value;
 }
 
 void cpu::set_registerLowByte(const int nr, const word_mode_t word_mode, const uint16_t value)
@@ -142,6 +155,54 @@ void cpu::set_registerLowByte(const int nr, const word_mode_t word_mode, const u
 	}
 }
 
+// the active register file holds R0...5 of the set selected by PSW bit 11
+// and the SP of the current run mode; write the outgoing ones back to their
+// bank and fetch the incoming ones whenever the PSW changes these
+void cpu::switch_register_banks(uint16_t new_psw)
+{
+	if (has_supervisor == false) [[unlikely]] {  // see cpu_models[]
+		if (new_psw & 0140000)
+			new_psw |= 0140000;
+		if (new_psw & 030000)
+			new_psw |= 030000;
+	}
+
+	const uint16_t changed = psw ^ new_psw;
+
+	if (changed & 004000) [[unlikely]] {
+		int cur_set = get_register_set();
+		memcpy(regs0_5[cur_set], regs, sizeof regs0_5[cur_set]);
+		memcpy(regs, regs0_5[!cur_set], sizeof regs0_5[cur_set]);
+	}
+
+	if (changed & 0140000) {
+		sp[psw >> 14] = regs[6];
+		regs[6]       = sp[new_psw >> 14];
+	}
+
+	const bool lowered = (new_psw & 0340) < (psw & 0340);
+
+	psw = new_psw;
+
+	if (lowered)
+		recheck_interrupts();
+}
+
+void cpu::set_cpu_model(const cpu_model_features_t & features)
+{
+	has_fpu        = features.has_fpu;
+	has_mxps       = features.has_mxps;
+	has_supervisor = features.has_supervisor;
+
+	switch_register_banks(psw);  // a mode that is no longer available
+}
+
+void cpu::load_active_registers()
+{
+	memcpy(regs, regs0_5[get_register_set()], sizeof regs0_5[0]);
+	regs[6] = sp[getPSW_runmode()];
+}
+
 bool cpu::put_result(const gam_rc_t & g, const uint16_t value)
 {
 	if (g.is_addr == false) {
@@ -150,20 +211,83 @@ bool cpu::put_result(const gam_rc_t & g, const uint16_t value)
 		return true;
 	}
 
+	if (g.physical.has_value()) [[likely]] {
+		b->write_rmw(g.addr, g.word_mode, value, g.physical.value());
+
+		return true;
+	}
+
 	return b->write(g.addr, g.word_mode, value, getPSW_runmode(), g.space) == false;
 }
 
 uint16_t cpu::add_register(const int nr, const uint16_t value)
 {
-	if (nr < 6)
-		return regs0_5[get_register_set()][nr] += value;
+	assert(nr >= 0 && nr < 8);
+
+	return regs[nr] += value;
+}
+
+bool cpu::fetch_cache_hit(const uint16_t a, const int run_mode) const
+{
+	return a >= fetch_cache.start && a <= fetch_cache.end && (a & 1) == 0 && run_mode == fetch_cache.run_mode &&
+		fetch_cache.generation == mmu_->get_mapping_generation();
+}
+
+// reads from I-space of the current mode, e.g. instructions and their operands
+uint16_t cpu::fetch_word(const uint16_t a)
+{
+	int run_mode = getPSW_runmode();
+
+	if (fetch_cache_hit(a, run_mode)) [[likely]]
+		return fetch_cache.m->read_word(fetch_cache.offset + a);
+
+	std::optional<std::pair<uint32_t, int> > physical;
+	uint16_t value = b->read(a, wm_word, run_mode, i_space, &physical);
+
+	if (physical.has_value())
+		fill_fetch_cache(a, run_mode, physical.value());
+	else
+		fetch_cache.run_mode = -1;  // I/O page, not cached
+
+	return value;
+}
+
+void cpu::fill_fetch_cache(const uint16_t a, const int run_mode, const std::pair<uint32_t, int> & physical)
+{
+	const auto [ m_offset, page_index ] = physical;
 
-	if (nr == 6)
-		return sp[getPSW_runmode()] += value;
+	uint16_t start = a & ~8191;
+	uint16_t end   = a |  8191;
 
-	assert(nr == 7);
+	// only the part of the page that passes the length check
+	if (mmu_->is_enabled()) {
+		uint16_t len = mmu_->get_pdr_len(page_index) * 64;
 
-	return pc += value;
+		if (mmu_->get_pdr_direction(page_index))  // expands downwards
+			start += len;
+		else
+			end = start + len + 63;
+	}
+
+	fetch_cache.run_mode = -1;
+
+	// the whole range must be in RAM and contiguous
+	if (m_offset < uint32_t(a - start))
+		return;
+
+	uint32_t physical_start = m_offset - (a - start);
+	uint32_t physical_end   = physical_start + (end - start);
+	memory  *m              = b->getRAM();
+
+	if (physical_end >= mmu_->get_io_base() || physical_end >= m->get_memory_size())
+		return;
+
+	fetch_cache.start      = start;
+	fetch_cache.end        = end;
+	fetch_cache.offset     = physical_start - start;
+	fetch_cache.run_mode   = run_mode;
+	fetch_cache.generation = mmu_->get_mapping_generation();
+	fetch_cache.m          = m;
 }
 
 void cpu::lowlevel_register_set(const uint8_t set, const uint8_t reg, const uint16_t value)
@@ -171,13 +295,17 @@ void cpu::lowlevel_register_set(const uint8_t set, const uint8_t reg, const uint
 	assert(set < 2);
 	assert(reg < 8);
 
-	if (reg < 6)
-		regs0_5[set][reg] = value;
+	if (reg < 6) {
+		if (set == get_register_set())
+			regs[reg] = value;
+		else
+			regs0_5[set][reg] = value;
+	}
 	else if (reg == 6)
-		sp[set == 0 ? 0 : 3] = value;
+		set_stackpointer(set == 0 ? 0 : 3, value);
 	else {
 		assert(reg == 7);
-		pc = value;
+		regs[7] = value;
 	}
 }
 
@@ -187,20 +315,20 @@ uint16_t cpu::lowlevel_register_get(const uint8_t set, const uint8_t reg) const
 	assert(reg < 8);
 
 	if (reg < 6)
-		return regs0_5[set][reg];
+		return set == get_register_set() ? regs[reg] : regs0_5[set][reg];
 
 	if (reg == 6)
-		return sp[set == 0 ? 0 : 3];
+		return get_stackpointer(set == 0 ? 0 : 3);
 
 	assert(reg == 7);
 
-	return pc;
+	return regs[7];
 }
 
 void cpu::lowlevel_register_sp_set(const uint8_t set, const uint16_t value)
 {
 	assert(set < 4);
-	sp[set] = value;
+	set_stackpointer(set, value);
 }
 
 bool cpu::getBitPSW(const int bit) const
@@ -230,6 +358,11 @@ bool cpu::getPSW_n() const
 
 void cpu::setBitPSW(const int bit, const bool v)
 {
+	if (bit >= 11) [[unlikely]] {  // register set or run mode
+		switch_register_banks((psw & ~(1 << bit)) | (v << bit));
+		return;
+	}
+
 	psw &= ~(1 << bit);
 	psw |= v << bit;
 }
@@ -256,8 +389,13 @@ void cpu::setPSW_n(const bool v)
 
 void cpu::setPSW_spl(const int v)
 {
+	const bool lowered = v < getPSW_spl();
+
 	psw &= ~(7 << 5);
 	psw |= v << 5;
+
+	if (lowered)
+		recheck_interrupts();
 }
 
 int cpu::getPSW_spl() const
@@ -270,10 +408,10 @@ void cpu::setPSW(const uint16_t v, const bool limited)
 	if (limited) {
 		int cur_mode  = std::max( v >> 14,       psw >> 14);
 		int prev_mode = std::max((v >> 12) & 3, (psw >> 12) & 3);
-		psw = (psw & 004340) | (v & 037) | (cur_mode << 14) | (prev_mode << 12);
+		switch_register_banks((psw & 004340) | (v & 037) | (cur_mode << 14) | (prev_mode << 12));
 	}
 	else {
-		psw = v & 0174377;  // mask off reserved bits
+		switch_register_banks(v & 0174377);  // mask off reserved bits
 	}
 }
 
@@ -288,37 +426,62 @@ bool cpu::check_pending_interrupts() const
 {
 	uint8_t start_level = getPSW_spl() + 1;
 
-	for(uint8_t i=start_level; i < 8; i++) {
-		if (queued_interrupts[i].empty() == false)
-			return true;
+	return (pending_levels & (0xff << start_level) & 0xff) != 0;
+}
+
+void cpu::clear_pending_level_if_empty(const uint8_t level)
+{
+	for(auto & word: queued_interrupts[level]) {
+		if (word)
+			return;
 	}
 
-	return false;
+	pending_levels.fetch_and(~(1 << level));
+
+	// a device may have queued something in the mean time
+	for(auto & word: queued_interrupts[level]) {
+		if (word) {
+			pending_levels.fetch_or(1 << level);
+			break;
+		}
+	}
 }
 
 void cpu::execute_any_pending_interrupt()
 {
-#if defined(FREERTOS)
-	xSemaphoreTake(qi_lock, portMAX_DELAY);
-#else
-	std::unique_lock<std::mutex> lck(qi_lock);
-#endif
+	uint8_t pending = pending_levels;
+	if (pending == 0)
+		return;
+
 	uint8_t current_level = getPSW_spl();
 
 	// uint8_t start_level = current_level <= 3 ? 0 : current_level + 1;
 	// PDP-11_70_Handbook_1977-78.pdf page 1-5, "processor priority"
 	uint8_t start_level   = current_level + 1;
 
-	for(uint8_t i=0; i < 8; i++) {
-		if (queued_interrupts[i].empty() == false) {
-			any_queued_interrupts = true;
+	// everything pending is masked: no need to look again until the
+	// priority drops (recheck_interrupts()) or a new request is queued
+	unsigned eligible = pending & (0xff << start_level) & 0xff;
+	if (eligible == 0)
+		return;
+
+	uint8_t level = std::bit_width(eligible) - 1;
+
+	for(int w=0; w<n_irq_slot_words; w++) {
+		uint32_t bits = queued_interrupts[level][w];
+
+		while(bits) {
+			uint32_t mask = uint32_t(1) << std::countr_zero(bits);
 
-			if (i < start_level)  // at least we know now that there's an interrupt scheduled
+			// only 'unqueue_interrupt' can take it away from under us
+			if ((queued_interrupts[level][w].fetch_and(~mask) & mask) == 0) {
+				bits = queued_interrupts[level][w];
 				continue;
+			}
+
+			clear_pending_level_if_empty(level);
 
-			auto     vector = queued_interrupts[i].begin();
-			uint16_t v      = *vector;
-			queued_interrupts[i].erase(vector);
+			uint16_t v = (w * 32 + std::countr_zero(mask)) * 4;
 
 			if (cnsl) {
 				if (v == 0100) {  // 50 Hz interrupt
@@ -332,79 +495,288 @@ void cpu::execute_any_pending_interrupt()
 				}
 			}
 
-			DOLOG(log_ss::LS_TRACE, "Invoking interrupt vector %o (IPL %d, current: %d)", v, i, current_level);
-			trap(v, i);
+			DOLOG(log_ss::LS_TRACE, "Invoking interrupt vector %o (IPL %d, current: %d)", v, level, current_level);
+			trap(v, level);
 
-#if defined(FREERTOS)
-			xSemaphoreGive(qi_lock);
-#endif
+			recheck_interrupts();  // one at an even higher level?
 			return;
 		}
 	}
 
-#if defined(FREERTOS)
-	xSemaphoreGive(qi_lock);
-#endif
+	clear_pending_level_if_empty(level);
+
+	recheck_interrupts();
+}
+
+// when something pending is above the current priority, let step() look at it
+void cpu::recheck_interrupts()
+{
+	if (check_pending_interrupts())
+		any_queued_interrupts = true;
+}
+
+// the vector can come from a register the guest programmed
+bool cpu::is_valid_interrupt(const uint8_t level, const uint16_t vector)
+{
+	if (level < 8 && vector < irq_vector_end && (vector & 3) == 0) [[likely]]
+		return true;
+
+	DOLOG(log_ss::LS_CPU, "Ignoring interrupt vector %o (IPL %d): out of range", vector, level);
+
+	return false;
 }
 
 void cpu::queue_interrupt(const uint8_t level, const uint16_t vector)
 {
+	if (is_valid_interrupt(level, vector) == false)
+		return;
+
+	const int slot = vector >> 2;
+	queued_interrupts[level][slot >> 5].fetch_or(uint32_t(1) << (slot & 31));
+	pending_levels.fetch_or(1 << level);
+	any_queued_interrupts = true;
+
+	DOLOG(log_ss::LS_TRACE, "Queueing interrupt vector %o (IPL %d, current: %d)", vector, level, getPSW_spl());
+
 #if defined(FREERTOS)
-	xSemaphoreTake(qi_lock, portMAX_DELAY);
+	if (uxQueueMessagesWaiting(qi_q) == 0) {
+		uint8_t value = 1;
+		xQueueSend(qi_q, &value, portMAX_DELAY);
+	}
 #else
-	std::unique_lock<std::mutex> lck(qi_lock);
+	if (in_wait) {
+		std::unique_lock<std::mutex> lck(qi_lock);
+		qi_cv.notify_one();
+	}
 #endif
+}
 
-	queued_interrupts[level].insert(vector);
-	DOLOG(log_ss::LS_TRACE, "Queueing interrupt vector %o (IPL %d, current: %d), n: %" PRIzu, vector, level, getPSW_spl(), queued_interrupts[level].size());
+void cpu::set_virtual_line_clock(const std::optional<uint32_t> ips)
+{
+	virtual_clock_ips = ips.value_or(0);
 
-#if defined(FREERTOS)
-	xSemaphoreGive(qi_lock);
+	b->getKW11_L()->set_wall_clock(ips.has_value() == false);
+}
 
+std::optional<uint32_t> cpu::get_virtual_line_clock() const
+{
+	if (virtual_clock_ips)
+		return virtual_clock_ips;
+
+	return { };
+}
+
+uint64_t cpu::us_to_event_time(const uint64_t us) const
+{
+	return std::max(uint64_t(1), us * (virtual_clock_ips ? virtual_clock_ips : default_instructions_per_second) / 1000000);
+}
+
+// moves the event time forward to the first event and runs it (and what is
+// due at the same moment), false if there's nothing scheduled
+bool cpu::skip_to_next_event()
+{
+	uint64_t due = scheduler->get_next_due();
+	if (due == UINT64_MAX)
+		return false;
+
+	uint64_t now = get_event_time();
+	if (due > now) {
+		if (speed_governor)  // skipped, but it is still time
+			speed_governor->add(uint32_t(std::min(uint64_t(UINT32_MAX), uint64_t((due - now) * 1000000000 / virtual_clock_ips))));
+
+		event_time_offset += due - now;
+	}
+
+	scheduler->run_due(get_event_time());
+
+	return true;
+}
+
+void cpu::wake_up()
+{
+	idle_wakeup = true;
+
+#if defined(FREERTOS)
 	if (uxQueueMessagesWaiting(qi_q) == 0) {
 		uint8_t value = 1;
 		xQueueSend(qi_q, &value, portMAX_DELAY);
 	}
 #else
-	qi_cv.notify_one();
+	if (in_wait) {
+		std::unique_lock<std::mutex> lck(qi_lock);
+		qi_cv.notify_one();
+	}
 #endif
+}
 
-	any_queued_interrupts = true;
+// invoked for a taken branch that jumps back at most idle_loop_max_words.
+// when the loop runs idle_loop_threshold times with the registers and PSW
+// unchanged and only tests memory/device registers, it can only end by an
+// interrupt or by a device (or DMA) changing what is read: the thread then
+// sleeps a bit instead of burning a host core. nothing is skipped, the loop
+// just runs slower.
+void cpu::check_idle_loop()
+{
+	const uint16_t start = getPC();
+
+	if (start != idle_loop.start || instruction_start != idle_loop.end) {
+		idle_loop.start    = start;
+		idle_loop.end      = instruction_start;
+		idle_loop.rejected = false;
+		idle_loop.count    = 0;
+	}
+	else if (idle_loop.rejected) {
+		return;
+	}
+
+	if (psw != idle_loop.psw || memcmp(regs, idle_loop.regs, sizeof regs) != 0) {
+		memcpy(idle_loop.regs, regs, sizeof regs);
+		idle_loop.psw   = psw;
+		idle_loop.count = 0;
+		return;
+	}
+
+	if (++idle_loop.count < idle_loop_threshold)
+		return;
+
+	idle_loop.count = 0;
+
+	// checked only now as most short loops are counting loops
+	if (is_idle_loop_body(idle_loop.start, idle_loop.end) == false) {
+		idle_loop.rejected = true;
+		return;
+	}
+
+	park_idle();
 }
 
-void cpu::unqueue_interrupt(const uint8_t level, const uint16_t vector)
+// only TST, CMP, BIT, branches and condition code operations, with operands
+// that do not modify registers (so no auto-increment/-decrement)
+bool cpu::is_idle_loop_body(const uint16_t start, const uint16_t end)
+{
+	const int run_mode = getPSW_runmode();
+
+	auto operand_ok = [](const int mode_reg, int *const n_words) {
+		const int mode = mode_reg >> 3;
+		const int reg  = mode_reg & 7;
+
+		if (mode == 6 || mode == 7 || ((mode == 2 || mode == 3) && reg == 7)) {
+			(*n_words)++;
+			return true;
+		}
+
+		return mode == 0 || mode == 1;
+	};
+
+	uint16_t a = start;
+
+	while(a != end) {
+		auto instr = b->peek_word(run_mode, a);
+		if (instr.has_value() == false)
+			return false;
+
+		const uint16_t i       = instr.value();
+		int            n_words = 1;
+		bool           ok      = false;
+
+		if ((i & 0077700) == 0005700)  // TST/TSTB
+			ok = operand_ok(i & 077, &n_words);
+		else if ((i & 0070000) == 0020000 || (i & 0070000) == 0030000)  // CMP/CMPB, BIT/BITB
+			ok = operand_ok((i >> 6) & 077, &n_words) && operand_ok(i & 077, &n_words);
+		else if (conditional_branch_instructions_evaluate(i).has_value())
+			ok = true;
+		else if ((i & 0177740) == 0000240)  // NOP, set/clear condition codes
+			ok = true;
+
+		if (ok == false)
+			return false;
+
+		a += n_words * 2;
+
+		if (a > end)  // the branch is not where it was expected
+			return false;
+	}
+
+	return true;
+}
+
+void cpu::park_idle()
 {
+	if (virtual_clock_ips)  // time only passes by executing instructions
+		return;
+
+	scheduler->run_all();  // as in WAIT: e.g. buffered output should go out now
+
+	DOLOG(log_ss::LS_TRACE, "idle loop %06o...%06o, parking", idle_loop.start, idle_loop.end);
+
 #if defined(FREERTOS)
-	xSemaphoreTake(qi_lock, portMAX_DELAY);
+	uint8_t rc = 0;  // wake_up() also puts something in the queue
+	xQueueReceive(qi_q, &rc, check_pending_interrupts() ? 0 : idle_park_ms / portTICK_PERIOD_MS);
 #else
+	using namespace std::chrono_literals;
 	std::unique_lock<std::mutex> lck(qi_lock);
+	in_wait = true;  // before the checks, so that wake_up() and 'queue_interrupt' won't miss us
+	if (idle_wakeup.exchange(false) == false && check_pending_interrupts() == false)
+		qi_cv.wait_for(lck, idle_park_ms * 1ms);
+	in_wait = false;
+	lck.unlock();
 #endif
 
-	queued_interrupts[level].erase(vector);
+	idle_wakeup = false;
 
-#if defined(FREERTOS)
-	xSemaphoreGive(qi_lock);
-#endif
+	if (speed_governor)  // sleeping is not lagging behind
+		speed_governor->reset();
+}
+
+void cpu::unqueue_interrupt(const uint8_t level, const uint16_t vector)
+{
+	if (is_valid_interrupt(level, vector) == false)
+		return;
+
+	const int slot = vector >> 2;
+	queued_interrupts[level][slot >> 5].fetch_and(~(uint32_t(1) << (slot & 31)));
+
+	clear_pending_level_if_empty(level);
+}
+
+std::array<std::set<uint16_t>, 8> cpu::get_queued_interrupts() const
+{
+	std::array<std::set<uint16_t>, 8> out;
+
+	for(uint8_t level=0; level<8; level++) {
+		for(int w=0; w<n_irq_slot_words; w++) {
+			uint32_t bits = queued_interrupts[level][w];
+
+			while(bits) {
+				int bit = std::countr_zero(bits);
+				out[level].insert((w * 32 + bit) * 4);
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	return out;
 }
 
 void cpu::add_to_MMR1(const int reg, const int delta)
 {
 	assert(reg >= 0 && reg < 8);
-	assert(delta >= -2 && delta <= 2);
+	assert(delta >= -8 && delta <= 8);  // FP11 D-format operands step by 8
 
-	if (mmu_->isMMR1Locked() == false) {
-		DOLOG(log_ss::LS_TRACE, "MMR1: add %d to register R%d", delta, reg);
-		mmu_->add_to_MMR1(delta, reg);
-	}
+	DOLOG(log_ss::LS_TRACE, "MMR1: add %d to register R%d", delta, reg);
+	MMR1_log = (MMR1_log << 8) | ((delta & 31) << 3) | reg;
 }
 
 // GAM = general addressing modes
-gam_rc_t cpu::getGAM(const uint8_t mode, const uint8_t reg, const word_mode_t word_mode, const bool read_value)
+// one instance per mode/word-mode combination so that the compiler can drop
+// everything that does not apply (e.g. register-direct is only a register read)
+template <uint8_t mode, word_mode_t word_mode>
+gam_rc_t cpu::getGAM_mode(const uint8_t reg, const bool read_value)
 {
 	d_i_space_t isR7_space = reg == 7 ? i_space : d_space;
-	gam_rc_t    g { word_mode, isR7_space, !!mode, 0, { } };
+	gam_rc_t    g { word_mode, isR7_space, mode != 0, 0, { }, { } };
 
-	if (mode == 0) {
+	if constexpr (mode == 0) {
 		g.reg   = reg;
 		g.value = get_register(reg) & word_mode_mask[word_mode];
 		return g;
@@ -413,70 +785,106 @@ gam_rc_t cpu::getGAM(const uint8_t mode, const uint8_t reg, const word_mode_t wo
 	d_i_space_t read_space = d_space;
 	int         run_mode   = getPSW_runmode();
 
-        uint16_t temp      = 0;
-	uint16_t next_word = 0;
-	int      delta     = 0;
-
-	switch(mode) {
-		case 1:  // (Rn)
-			g.addr     = get_register(reg);
-			read_space = isR7_space;
-			break;
-		case 2:  // (Rn)+  /  #n
-			g.addr  = get_register(reg);
-			delta   = word_mode == wm_word || reg >= 6 ? 2 : 1;
-			add_register(reg, delta);
-			add_to_MMR1(reg, delta);
-			read_space = isR7_space;
-			break;
-		case 3:  // @(Rn)+  /  @#a
-			g.addr  = b->read(get_register(reg), wm_word, run_mode, isR7_space);
-			add_to_MMR1(reg, 2);
-			g.space = d_space;
-			// might be wrong: the adds should happen when the read is really performed(?), because of traps
-			add_register(reg, 2);
-			break;
-		case 4:  // -(Rn)
-			delta   = word_mode == wm_word || reg >= 6 ? -2 : -1;
-			temp    = add_register(reg, delta);
-			add_to_MMR1(reg, delta);
-			g.space = d_space;
-			g.addr  = temp;
-			read_space = isR7_space;
-			break;
-		case 5:  // @-(Rn)
-			temp    = add_register(reg, -2);
-			add_to_MMR1(reg, -2);
-			g.addr  = b->read(temp, wm_word, run_mode, isR7_space);
-			g.space = d_space;
-			break;
-		case 6:  // x(Rn)  /  a
-			next_word = b->read(getPC(), wm_word, run_mode, i_space);
-			add_register(7, + 2);
-			g.addr  = get_register(reg) + next_word;
-			g.space = d_space;
-			break;
-		case 7:  // @x(Rn)  /  @a
-			next_word = b->read(getPC(), wm_word, run_mode, i_space);
-			add_register(7, + 2);
-			g.addr  = b->read(get_register(reg) + next_word, wm_word, run_mode, d_space);
-			g.space = d_space;
-			break;
+	if constexpr (mode == 1) {  // (Rn)
+		g.addr     = get_register(reg);
+		read_space = isR7_space;
+	}
+	else if constexpr (mode == 2) {  // (Rn)+  /  #n
+		g.addr    = get_register(reg);
+		int delta = word_mode == wm_word || reg >= 6 ? 2 : 1;
+		add_register(reg, delta);
+		add_to_MMR1(reg, delta);
+		read_space = isR7_space;
+	}
+	else if constexpr (mode == 3) {  // @(Rn)+  /  @#a
+		g.addr  = b->read(get_register(reg), wm_word, run_mode, isR7_space);
+		add_to_MMR1(reg, 2);
+		g.space = d_space;
+		// might be wrong: the adds should happen when the read is really performed(?), because of traps
+		add_register(reg, 2);
+	}
+	else if constexpr (mode == 4) {  // -(Rn)
+		int delta = word_mode == wm_word || reg >= 6 ? -2 : -1;
+		uint16_t temp = add_register(reg, delta);
+		add_to_MMR1(reg, delta);
+		g.space = d_space;
+		g.addr  = temp;
+		read_space = isR7_space;
+	}
+	else if constexpr (mode == 5) {  // @-(Rn)
+		uint16_t temp = add_register(reg, -2);
+		add_to_MMR1(reg, -2);
+		g.addr  = b->read(temp, wm_word, run_mode, isR7_space);
+		g.space = d_space;
+	}
+	else if constexpr (mode == 6) {  // x(Rn)  /  a
+		uint16_t next_word = fetch_word(getPC());
+		add_register(7, + 2);
+		g.addr  = get_register(reg) + next_word;
+		g.space = d_space;
+	}
+	else if constexpr (mode == 7) {  // @x(Rn)  /  @a
+		uint16_t next_word = fetch_word(getPC());
+		add_register(7, + 2);
+		g.addr  = b->read(get_register(reg) + next_word, wm_word, run_mode, d_space);
+		g.space = d_space;
 	}
 
-	if (read_value)
-		g.value = b->read(g.addr, word_mode, run_mode, read_space);
+	if (read_value)  // remember where the value came from so that a write-back needs no second translation
+		g.value = b->read(g.addr, word_mode, run_mode, read_space, read_space == g.space ? &g.physical : nullptr);
 
 	assert(g.value < 256 || word_mode == wm_word);
 
 	return g;
 }
 
+template <word_mode_t word_mode>
+gam_rc_t cpu::getGAM_wm(const uint8_t mode, const uint8_t reg, const bool read_value)
+{
+	switch(mode) {
+		case 0: return getGAM_mode<0, word_mode>(reg, read_value);
+		case 1: return getGAM_mode<1, word_mode>(reg, read_value);
+		case 2: return getGAM_mode<2, word_mode>(reg, read_value);
+		case 3: return getGAM_mode<3, word_mode>(reg, read_value);
+		case 4: return getGAM_mode<4, word_mode>(reg, read_value);
+		case 5: return getGAM_mode<5, word_mode>(reg, read_value);
+		case 6: return getGAM_mode<6, word_mode>(reg, read_value);
+	}
+
+	return getGAM_mode<7, word_mode>(reg, read_value);
+}
+
+// register-direct operands are known when the instruction is decoded, see
+// double_operand_instructions(): then there's no switch on the mode at all
+template <word_mode_t word_mode, bool is_register>
+gam_rc_t cpu::get_operand(const uint8_t mode, const uint8_t reg, const bool read_value)
+{
+	if constexpr (is_register)
+		return getGAM_mode<0, word_mode>(reg, read_value);
+	else
+		return getGAM_wm<word_mode>(mode, reg, read_value);
+}
+
+gam_rc_t cpu::getGAM(const uint8_t mode, const uint8_t reg, const word_mode_t word_mode, const bool read_value)
+{
+	assert(mode < 8);
+
+	if (word_mode == wm_byte)
+		return getGAM_wm<wm_byte>(mode, reg, read_value);
+
+	return getGAM_wm<wm_word>(mode, reg, read_value);
+}
+
 bool cpu::putGAM(const gam_rc_t & g, const uint16_t value)
 {
 	assert(value < 256 || g.word_mode == wm_word);
 
 	if (g.is_addr) {
+		if (g.physical.has_value()) [[likely]] {
+			b->write_rmw(g.addr, g.word_mode, value, g.physical.value());
+			return true;
+		}
+
 		auto rc = b->write(g.addr, g.word_mode, value, getPSW_runmode(), g.space);
 		return rc == false;
 	}
@@ -493,8 +901,40 @@ gam_rc_t cpu::getGAMAddress(const uint8_t mode, const int reg, const word_mode_t
 
 bool cpu::double_operand_instructions(const uint16_t instr)
 {
-	const uint8_t     operation = (instr >> 12) & 7;
-	const word_mode_t word_mode = instr & 0x8000 ? wm_byte : wm_word;
+	const uint8_t operation = (instr >> 12) & 7;
+
+	if (operation == 0b000)
+		return single_operand_instructions(instr);
+
+	if (operation == 0b111) {
+		if (instr & 0x8000) [[unlikely]]
+			return false;
+
+		return additional_double_operand_instructions(instr);
+	}
+
+	// select the variant for the word mode and for which operands are
+	// register-direct (e.g. MOV R,R / ADD R,R)
+	const bool src_is_register = (instr & 07000) == 0;
+	const bool dst_is_register = (instr & 00070) == 0;
+
+	switch(((instr >> 13) & 4) | (src_is_register << 1) | dst_is_register) {
+		case 0: return double_operand<wm_word, false, false>(instr);
+		case 1: return double_operand<wm_word, false, true >(instr);
+		case 2: return double_operand<wm_word, true,  false>(instr);
+		case 3: return double_operand<wm_word, true,  true >(instr);
+		case 4: return double_operand<wm_byte, false, false>(instr);
+		case 5: return double_operand<wm_byte, false, true >(instr);
+		case 6: return double_operand<wm_byte, true,  false>(instr);
+	}
+
+	return double_operand<wm_byte, true, true>(instr);
+}
+
+template <word_mode_t word_mode, bool src_is_register, bool dst_is_register>
+bool cpu::double_operand(const uint16_t instr)
+{
+	const uint8_t operation  = (instr >> 12) & 7;
 
 	const uint8_t src        = (instr >> 6) & 63;
 	const uint8_t src_mode   = (src >> 3) & 7;
@@ -505,18 +945,18 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 	const uint8_t dst_reg    = dst & 7;
 
 	switch(operation) {
-		case 0b000:
-			return single_operand_instructions(instr);
-
 		case 0b001: { // MOV/MOVB Move Word/Byte
-				    gam_rc_t g_src     = getGAM(src_mode, src_reg, word_mode);
+				    gam_rc_t g_src     = get_operand<word_mode, src_is_register>(src_mode, src_reg);
 				    bool     set_flags = true;
 
-				    if (word_mode == wm_byte && dst_mode == 0) {
-					    set_register(dst_reg, int8_t(g_src.value));  // int8_t: sign extension
+				    if constexpr (dst_is_register) {
+					    if constexpr (word_mode == wm_byte)
+						    set_register(dst_reg, int8_t(g_src.value));  // int8_t: sign extension
+					    else
+						    set_register(dst_reg, g_src.value);
 				    }
 				    else {
-					    auto g_dst = getGAMAddress(dst_mode, dst_reg, word_mode);
+					    auto g_dst = get_operand<word_mode, false>(dst_mode, dst_reg, false);
 					    set_flags = putGAM(g_dst, g_src.value);
 				    }
 
@@ -527,8 +967,8 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 			    }
 
 		case 0b010: { // CMP/CMPB Compare Word/Byte
-				    gam_rc_t g_src = getGAM(src_mode, src_reg, word_mode);
-				    auto     g_dst = getGAM(dst_mode, dst_reg, word_mode);
+				    gam_rc_t g_src = get_operand<word_mode, src_is_register>(src_mode, src_reg);
+				    auto     g_dst = get_operand<word_mode, dst_is_register>(dst_mode, dst_reg);
 
 				    uint16_t temp  = (g_src.value - g_dst.value) & word_mode_mask[word_mode];
 
@@ -541,8 +981,8 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 			    }
 
 		case 0b011: { // BIT/BITB Bit Test Word/Byte
-				    gam_rc_t g_src  = getGAM(src_mode, src_reg, word_mode);
-				    auto     g_dst  = getGAM(dst_mode, dst_reg, word_mode);
+				    gam_rc_t g_src  = get_operand<word_mode, src_is_register>(src_mode, src_reg);
+				    auto     g_dst  = get_operand<word_mode, dst_is_register>(dst_mode, dst_reg);
 
 				    uint16_t result = (g_dst.value & g_src.value) & word_mode_mask[word_mode];
 
@@ -552,9 +992,9 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 			    }
 
 		case 0b100: { // BIC/BICB Bit Clear Word/Byte
-				  gam_rc_t g_src  = getGAM(src_mode, src_reg, word_mode);
+				  gam_rc_t g_src  = get_operand<word_mode, src_is_register>(src_mode, src_reg);
 
-				  if (dst_mode == 0) {
+				  if constexpr (dst_is_register) {
 					  uint16_t v      = get_register(dst_reg);  // need the full word
 					  uint16_t result = v & ~g_src.value;
 
@@ -563,7 +1003,7 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 					  setPSW_flags_nzv(result, word_mode);
 				  }
 				  else {
-					  auto     g_dst  = getGAM(dst_mode, dst_reg, word_mode);
+					  auto     g_dst  = get_operand<word_mode, false>(dst_mode, dst_reg);
 					  uint16_t result = g_dst.value & ~g_src.value;
 
 					  if (put_result(g_dst, result))
@@ -574,9 +1014,9 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 			    }
 
 		case 0b101: { // BIS/BISB Bit Set Word/Byte
-				  gam_rc_t g_src  = getGAM(src_mode, src_reg, word_mode);
+				  gam_rc_t g_src  = get_operand<word_mode, src_is_register>(src_mode, src_reg);
 
-				  if (dst_mode == 0) {
+				  if constexpr (dst_is_register) {
 					  uint16_t v      = get_register(dst_reg);  // need the full word
 					  uint16_t result = v | g_src.value;
 
@@ -587,7 +1027,7 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 					  setPSW_v(false);
 				  }
 				  else {
-					  auto     g_dst  = getGAM(dst_mode, dst_reg, word_mode);
+					  auto     g_dst  = get_operand<word_mode, false>(dst_mode, dst_reg);
 					  uint16_t result = g_dst.value | g_src.value;
 
 					  if (put_result(g_dst, result)) {
@@ -601,19 +1041,24 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 			    }
 
 		case 0b110: { // ADD/SUB Add/Subtract Word
-				    auto     g_ssrc = getGAM(src_mode, src_reg, wm_word);
-				    auto     g_dst  = getGAM(dst_mode, dst_reg, wm_word);
+				    // the byte-mode bit selects SUB here, both are word operations
+				    auto     g_ssrc = get_operand<wm_word, src_is_register>(src_mode, src_reg);
+				    auto     g_dst  = get_operand<wm_word, dst_is_register>(dst_mode, dst_reg);
 				    int16_t  result = 0;
 
-				    if (instr & 0x8000)  // SUB
+				    if constexpr (word_mode == wm_byte)  // SUB
 					    result = g_dst.value - g_ssrc.value;
 				    else  // ADD
 					    result = g_dst.value + g_ssrc.value;
 
-				    bool set_flags = putGAM(g_dst, result);
+				    bool set_flags = true;
+				    if constexpr (dst_is_register)
+					    set_register(dst_reg, result);
+				    else
+					    set_flags = putGAM(g_dst, result);
 
 				    if (set_flags) {
-					    if (instr & 0x8000) {  // SUB
+					    if constexpr (word_mode == wm_byte) {  // SUB
 						    setPSW_v(SIGN((g_dst.value ^ g_ssrc.value) & (~g_ssrc.value ^ result), wm_word));
 						    setPSW_c(uint16_t(g_dst.value) < uint16_t(g_ssrc.value));
 					    }
@@ -628,13 +1073,6 @@ bool cpu::double_operand_instructions(const uint16_t instr)
 
 				    return true;
 			    }
-
-		case 0b111: {
-			if (word_mode == wm_byte) [[unlikely]]
-				return false;
-
-			return additional_double_operand_instructions(instr);
-		}
 	}
 
 	return false;
@@ -915,7 +1353,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  auto    a         = getGAM(dst_mode, dst_reg, word_mode);
 						  int32_t vl        = (a.value + 1) & word_mode_mask[word_mode];
 
-						  bool    set_flags = b->write(a.addr, a.word_mode, vl, getPSW_runmode(), a.space) == false;
+						  bool    set_flags = put_result(a, vl);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(vl, word_mode));
@@ -945,7 +1383,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  auto     a         = getGAM(dst_mode, dst_reg, word_mode);
 						  int32_t  vl        = (a.value - 1) & word_mode_mask[word_mode];
 
-						  bool     set_flags = b->write(a.addr, a.word_mode, vl, getPSW_runmode(), a.space) == false;
+						  bool     set_flags = put_result(a, vl);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(vl, word_mode));
@@ -976,7 +1414,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  auto     a = getGAM(dst_mode, dst_reg, word_mode);
 						  uint16_t v = -a.value;
 
-						  bool set_flags = b->write(a.addr, a.word_mode, v, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, v);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(v, word_mode));
@@ -1012,7 +1450,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  bool           org_c = getPSW_c();
 						  uint16_t       v     = (vo + org_c) & (word_mode == wm_byte ? 0x00ff : 0xffff);
 
-						  bool set_flags = b->write(a.addr, a.word_mode, v, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, v);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(v, word_mode));
@@ -1048,7 +1486,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  bool           org_c = getPSW_c();
 						  uint16_t       v     = (vo - org_c) & word_mode_mask[word_mode];
 
-						  bool set_flags = b->write(a.addr, a.word_mode, v, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, v);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(v, word_mode));
@@ -1099,7 +1537,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						  else
 							  temp = (t >> 1) | (getPSW_c() << 15);
 
-						  bool set_flags = b->write(a.addr, a.word_mode, temp, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, temp);
 
 						  if (set_flags) {
 							  setPSW_c(new_carry);
@@ -1148,7 +1586,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 							  temp = (t << 1) | getPSW_c();
 						  }
 
-						  bool set_flags = b->write(a.addr, a.word_mode, temp, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, temp);
 
 						  if (set_flags) {
 							  setPSW_c(new_carry);
@@ -1193,7 +1631,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 							  v >>= 1;
 						  v |= hb;
 
-						  bool set_flags = b->write(a.addr, a.word_mode, v, getPSW_runmode(), a.space) == false;
+						  bool set_flags = put_result(a, v);
 
 						  if (set_flags) {
 							  setPSW_n(SIGN(v, word_mode));
@@ -1224,7 +1662,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						 uint16_t vl  = a.value;
 						 uint16_t v   = (vl << 1) & word_mode_mask[word_mode];
 
-						 bool set_flags = b->write(a.addr, a.word_mode, v, getPSW_runmode(), a.space) == false;
+						 bool set_flags = put_result(a, v);
 
 						 if (set_flags) {
 							 setPSW_n(SIGN(v, word_mode));
@@ -1242,7 +1680,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 
 					 if (dst_mode == 0) {
 						 if (dst_reg == 6)
-							v = sp[getPSW_prev_runmode()];
+							v = get_stackpointer(getPSW_prev_runmode());
 						 else
 							v = get_register(dst_reg);
 					 }
@@ -1270,7 +1708,7 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 
 					 if (dst_mode == 0) {
 						if (dst_reg == 6)
-							sp[getPSW_prev_runmode()] = v;
+							set_stackpointer(getPSW_prev_runmode(), v);
 						else
 							set_register(dst_reg, v);
 					 }
@@ -1288,12 +1726,16 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 
 		case 0b000110100: // MARK/MTPS (put something in PSW)
 				 if (word_mode == wm_byte) {  // MTPS
-#if 0  // not in the PDP-11/70
-					 psw &= 0xff00;  // only alter lower 8 bits
-					 psw |= getGAM(dst_mode, dst_reg, word_mode).value & 0xef;  // can't change bit 4
-#else
-					 trap(010);  // reserved instruction
-#endif
+					 if (has_mxps == false) {  // e.g. not in the PDP-11/70
+						 trap(010);  // reserved instruction
+						 break;
+					 }
+
+					 uint16_t v    = getGAM(dst_mode, dst_reg, word_mode).value;
+					 // only alter the lower 8 bits, can't change bit 4 (T) and
+					 // outside of kernel mode not the priority
+					 uint16_t keep = getPSW_runmode() ? 0177760 : 0177420;
+					 switch_register_banks((psw & keep) | (v & 0357 & ~keep));
 				 }
 				 else {
 					 set_register(6, getPC() + dst * 2);
@@ -1306,8 +1748,12 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 
 		case 0b000110111: {  // MFPS (get PSW to something) / SXT
 				 if (word_mode == wm_byte) {  // MFPS
-#if 0  // not in the PDP-11/70
-					 auto g_dst = getGAM(dst_mode, dst_reg, word_mode);
+					 if (has_mxps == false) {  // e.g. not in the PDP-11/70
+						 trap(010);  // reserved instruction
+						 break;
+					 }
+
+					 auto g_dst = getGAMAddress(dst_mode, dst_reg, word_mode);
 
 					 uint16_t temp      = psw & 0xff;
 					 bool     extend_b7 = psw & 128;
@@ -1322,9 +1768,6 @@ bool cpu::single_operand_instructions(const uint16_t instr)
 						 setPSW_v(false);
 						 setPSW_n(extend_b7);
 					 }
-#else
-					 trap(010);  // reserved instruction
-#endif
 				 }
 				 else {  // SXT
 					 auto     g_dst = getGAM(dst_mode, dst_reg, word_mode);
@@ -1406,9 +1849,13 @@ bool cpu::conditional_branch_instructions(const uint16_t instr)
 	if  (take.has_value() == false)
 		return false;
 
-	if (take.value())
+	if (take.value()) {
 		add_register(7, offset * 2);
 
+		if (offset < 0 && offset >= -idle_loop_max_words) [[unlikely]]
+			check_idle_loop();
+	}
+
 	return true;
 }
 
@@ -1505,6 +1952,20 @@ bool cpu::misc_operations(const uint16_t instr)
 
 				do
 				{
+					// with virtual time nothing happens while waiting: skip to
+					// the next device event (e.g. a KW11-L tick) instead. only
+					// when nothing is scheduled, wait for e.g. terminal input
+					if (virtual_clock_ips) {
+						if (check_pending_interrupts() == false && skip_to_next_event())
+							continue;
+					}
+					// on the wall clock, time passes while waiting while the
+					// instruction count does not: run what is pending (e.g.
+					// sending buffered terminal output)
+					else {
+						scheduler->run_all();
+					}
+
 					// wait intervals of 100 ms. if no interrupt for 1,5 seconds, then maybe things are stuck.
 #if defined(FREERTOS)
 					uint8_t rc = 0;
@@ -1512,8 +1973,10 @@ bool cpu::misc_operations(const uint16_t instr)
 #else
 					using namespace std::chrono_literals;
 					std::unique_lock<std::mutex> lck(qi_lock);
-					if (check_pending_interrupts() == false)
+					in_wait = true;  // before the check, so that 'queue_interrupt' and wake_up() won't miss us
+					if (idle_wakeup.exchange(false) == false && check_pending_interrupts() == false)
 						qi_cv.wait_for(lck, 100 * 1ms);
+					in_wait = false;
 					lck.unlock();
 #endif
 					if (wait_stuck == false && get_us() - start > 1500000) {
@@ -1596,8 +2059,7 @@ bool cpu::misc_operations(const uint16_t instr)
 
 		// PUSH link
 		push_stack(get_register(link_reg));
-		if (mmu_->isMMR1Locked() == false)
-			mmu_->add_to_MMR1(-2, 6);
+		add_to_MMR1(6, -2);
 
 		// MOVE PC,link
 		set_register(link_reg, getPC());
@@ -1648,15 +2110,28 @@ const char *vector_name(const uint16_t vector)
 	}
 }
 
+std::array<uint32_t, n_trap_vectors> cpu::get_trap_counts(const int run_mode) const
+{
+	if (run_mode != -1)
+		return trap_counts[run_mode];
+
+	std::array<uint32_t, n_trap_vectors> out { };
+	for(auto & mode_counts: trap_counts) {
+		for(int i=0; i<n_trap_vectors; i++)
+			out[i] += mode_counts[i];
+	}
+
+	return out;
+}
+
 void cpu::trap(uint16_t vector, const int new_ipl)
 {
 	DOLOG(log_ss::LS_CPU, "*** CPU::TRAP %o, new-ipl: %d, run mode: %d, name: %s ***", vector, new_ipl, getPSW_runmode(), vector_name(vector));
 
 	last_trap_vector = vector;
 
-	auto insert_rc = trap_counts.insert({ vector, 1 });
-	if (insert_rc.second == false)
-		insert_rc.first->second++;
+	if (vector < 01000) [[likely]]
+		trap_counts[getPSW_runmode()][vector / 4]++;
 	trap_counter++;
 
 	uint16_t before_psw = 0;
@@ -1685,7 +2160,7 @@ void cpu::trap(uint16_t vector, const int new_ipl)
 			before_pc  = getPC();
 
 			// make sure the trap vector is retrieved from kernel space
-			psw &= 037777;  // mask off 14/15 to make it into kernel-space
+			switch_register_banks(psw & 037777);  // mask off 14/15 to make it into kernel-space
 
 			auto space = mmu_->get_use_data_space(0) ? d_space : i_space;
 			setPC(b->read_word(vector + 0, space));
@@ -1714,7 +2189,7 @@ void cpu::trap(uint16_t vector, const int new_ipl)
 
 			// if we reach this point then the trap was processed without causing
 			// another trap
-			DOLOG(log_ss::LS_TRACE, "Trapping to %06o with PSW %06o", pc, psw);
+			DOLOG(log_ss::LS_TRACE, "Trapping to %06o with PSW %06o", getPC(), psw);
 		}
 		catch(const int exception) {
 			DOLOG(log_ss::LS_TRACE, "trap during execution of trap (%d)", exception);
@@ -2360,6 +2835,42 @@ std::unordered_map<std::string, std::vector<std::string> > cpu::disassemble(cons
 		if (text.empty() == false && next_word != -1)
 			instruction_words.push_back(next_word);
 	}
+	else if ((instruction & 0170000) == 0170000) {  // FP11
+		std::string fp_name  = fpu->get_mnemonic(instruction);
+		uint8_t     fp_group = (instruction >> 8) & 15;
+		// STEXP, STCFI, LDEXP, LDCIF and the FPS instructions work on integers
+		bool        is_fp_op = fp_group == 1 || (fp_group >= 2 && fp_group != 012 && fp_group != 013 && fp_group != 015 && fp_group != 016);
+		std::string operand;
+
+		if (fp_group == 0 && (instruction & 0300) == 0) {
+			// CFCC, SETF, etc
+		}
+		else if (is_fp_op && (dst_register >> 3) == 0) {
+			operand = format("AC%d", dst_register & 7);
+		}
+		else {
+			auto addressing = addressing_to_string(dst_register, addr + 2, wm_word);
+			might_be_io = addressing.valid == false;
+
+			if (addressing.instruction_part != -1)
+				instruction_words.push_back(addressing.instruction_part);
+
+			work_values.push_back(addressing.work_value);
+
+			operand = addressing.operand;
+		}
+
+		std::string ac = format("AC%d", (instruction >> 6) & 3);
+
+		if (fp_name.empty())
+			text.clear();
+		else if (fp_group < 2)
+			text = operand.empty() ? fp_name : fp_name + space + operand;
+		else if (fp_group == 010 || fp_group == 012 || fp_group == 013 || fp_group == 014)  // stores
+			text = fp_name + space + ac + comma + operand;
+		else
+			text = fp_name + space + operand + comma + ac;
+	}
 	else if (do_opcode == 0b111) {
 		if (word_mode == wm_byte)
 			name = "?";
@@ -2667,7 +3178,7 @@ std::unordered_map<std::string, std::vector<std::string> > cpu::disassemble(cons
 		if (i < 6)
 			registers.push_back(format("%06o", get_register(i)));
 		else if (i == 6)
-			registers.push_back(format("%06o", sp[psw >> 14]));
+			registers.push_back(format("%06o", get_register(6)));
 		else
 			registers.push_back(format("%06o", addr));
 	}
@@ -2675,7 +3186,7 @@ std::unordered_map<std::string, std::vector<std::string> > cpu::disassemble(cons
 
 	std::vector<std::string> registers_sp;
 	for(int i=0; i<4; i++)
-		registers_sp.push_back(format("%06o", sp[i]));
+		registers_sp.push_back(format("%06o", get_stackpointer(i)));
 	out.insert({ "sp", registers_sp });
 
 	// PSW
@@ -2702,6 +3213,129 @@ std::unordered_map<std::string, std::vector<std::string> > cpu::disassemble(cons
 	return out;
 }
 
+// MOV (Rs)+,(Rd)+ or CLR (Rd)+ followed by a SOB that jumps back to it
+// (bcopy, clearseg): when nothing can come in between (no interrupt
+// pending, no delayed trap), the SOB is executed right away and the rest
+// of the loop is handed to execute_block_loop(). the SOB goes through the
+// regular handler so flags, MMR1/MMR2 and aborts behave as usual.
+void cpu::try_block_loop(const uint16_t instr)
+{
+	// only the pattern test for all other instructions
+	const bool is_mov = (instr & 0177070) == 0012020;  // MOV (Rs)+,(Rd)+
+	const bool is_clr = (instr & 0177770) == 0005020;  // CLR (Rn)+
+	if (is_mov == false && is_clr == false) [[likely]]
+		return;
+
+	if (any_queued_interrupts || delayed_trap.has_value())
+		return;
+
+	const uint16_t next_pc = getPC();
+	if (fetch_cache_hit(next_pc, getPSW_runmode()) == false)
+		return;
+
+	const uint16_t next = fetch_cache.m->read_word(fetch_cache.offset + next_pc);
+	if ((next & 0177000) != 0077000)  // SOB
+		return;
+
+	instructions_executed++;
+
+	instruction_start = next_pc;
+	MMR1_log          = 0;
+	add_register(7, 2);
+
+	double_operand_instructions(next);  // SOB is in the additional double operand set
+
+	if (getPC() == next_pc - 2)  // looping
+		execute_block_loop(instr, next);
+}
+
+// MOV (Rs)+,(Rd)+ or CLR (Rd)+ with a SOB jumping back to it, e.g. bcopy
+// and clearseg: run the remaining iterations that stay within the current
+// source and destination pages as one memmove/memset. the end state is the
+// same as after executing them one by one, ending with the SOB.
+void cpu::execute_block_loop(const uint16_t instr, const uint16_t sob)
+{
+	const bool is_clr  = (instr & 0177770) == 0005020;
+	const int  src_reg = (instr >> 6) & 7;
+	const int  dst_reg = instr & 7;
+	const int  cnt_reg = (sob >> 6) & 7;
+
+	if (dst_reg >= 6 || cnt_reg >= 6 || cnt_reg == dst_reg)
+		return;
+
+	if (is_clr == false && (src_reg >= 6 || src_reg == dst_reg || src_reg == cnt_reg))
+		return;
+
+	uint16_t src = regs[src_reg];
+	uint16_t dst = regs[dst_reg];
+	uint32_t n   = regs[cnt_reg];  // iterations left
+
+	n = std::min(n, uint32_t(8192 - (dst & 8191)) / 2);
+	if (is_clr == false)
+		n = std::min(n, uint32_t(8192 - (src & 8191)) / 2);
+
+	if (n == 0)
+		return;
+
+	const int run_mode = getPSW_runmode();
+	if (fetch_cache_hit(getPC(), run_mode) == false)
+		return;
+
+	auto      p_dst    = b->get_ram_span(dst, n * 2, run_mode, d_space);
+	if (p_dst.has_value() == false)
+		return;
+
+	const uint32_t m_dst = p_dst.value().first;
+
+	// the loop must not overwrite itself
+	const uint32_t m_code = fetch_cache.offset + getPC();
+	if (m_dst < m_code + 4 && m_code < m_dst + n * 2)
+		return;
+
+	memory *const m = b->getRAM();
+
+	if (is_clr) {
+		m->clear(m_dst, n * 2);
+
+		setPSW_n(false);
+		setPSW_z(true);
+		setPSW_v(false);
+		setPSW_c(false);
+	}
+	else {
+		auto p_src = b->get_ram_span(src, n * 2, run_mode, d_space);
+		if (p_src.has_value() == false)
+			return;
+
+		const uint32_t m_src = p_src.value().first;
+
+		// a word-by-word copy to a bit further on would repeat the start
+		if (m_dst > m_src && m_dst < m_src + n * 2)
+			return;
+
+		m->move(m_dst, m_src, n * 2);
+		mmu_->set_page_accessed(p_src.value().second);
+
+		setPSW_flags_nzv(m->read_word(m_dst + (n - 1) * 2), wm_word);
+
+		regs[src_reg] += n * 2;
+	}
+
+	mmu_->set_page_written_to(p_dst.value().second);
+
+	regs[dst_reg] += n * 2;
+	regs[cnt_reg] -= n;
+
+	instructions_executed += n * 2;
+
+	// state as after the last SOB
+	instruction_start = getPC() + 2;
+	MMR1_log          = 0;
+
+	if (regs[cnt_reg] == 0)
+		setPC(getPC() + 4);
+}
+
 bool cpu::step()
 {
 	instructions_executed++;
@@ -2722,18 +3356,28 @@ bool cpu::step()
 		execute_any_pending_interrupt();
 	}
 
+	if (get_event_time() >= scheduler->get_next_due()) [[unlikely]]
+		scheduler->run_due(get_event_time());
+
+	if (speed_governor) [[unlikely]]  // no 11/70 instruction is faster than 300 ns
+		speed_governor->add(std::max(calc_instruction_duration(getPC()), uint32_t(300)));
+
 	try {
-		mmu_->MMRStartInstruction(pc);
-		uint16_t instr = b->read_word(pc);
+		instruction_start = getPC();
+		MMR1_log          = 0;
+		uint16_t instr = fetch_word(getPC());
 		add_register(7, 2);
 
-		if (double_operand_instructions(instr) || conditional_branch_instructions(instr) || condition_code_operations(instr) || misc_operations(instr)) {
+		if (double_operand_instructions(instr) || conditional_branch_instructions(instr) || condition_code_operations(instr) || misc_operations(instr) || (has_fpu && fpu->execute(instr))) {
+			if (allow_block_loops)
+				try_block_loop(instr);
+
 			return true;
 		}
 
-		DOLOG(log_ss::LS_CPU, "UNHANDLED instruction %06o @ %06o", instr, pc - 2);
+		DOLOG(log_ss::LS_CPU, "UNHANDLED instruction %06o @ %06o", instr, getPC() - 2);
 
-		trap(010);  // floating point nog niet geimplementeerd
+		trap(010);
 
 		return false;
 	}
@@ -2751,15 +3395,15 @@ JsonDocument cpu::serialize()
 
 	for(int set=0; set<2; set++) {
 		for(int regnr=0; regnr<6; regnr++)
-			j[format("register-%d-%d", set, regnr)] = regs0_5[set][regnr];
+			j[format("register-%d-%d", set, regnr)] = lowlevel_register_get(set, regnr);
 	}
 
 	for(int spnr=0; spnr<4; spnr++)
-		j[format("sp-%d", spnr)] = sp[spnr];
+		j[format("sp-%d", spnr)] = get_stackpointer(spnr);
 
-        j["pc"]                    = pc;
+        j["pc"]                    = getPC();
         j["psw"]                   = psw;
-        j["fpsr"]                  = fpsr;
+        j["fpsr"]                  = fpu->get_fps();
         j["stack_limit_register"]  = stack_limit_register;
         j["processing_trap_depth"] = processing_trap_depth;
         j["instructions_executed"] = instructions_executed;
@@ -2767,11 +3411,12 @@ JsonDocument cpu::serialize()
 	if (delayed_trap.has_value())
 		j["delayed_trap"] = delayed_trap.value();
 
+	auto        queued = get_queued_interrupts();
 	JsonVariant j_queued_interrupts;
 	for(int il=0; il<8; il++) {
 		JsonDocument ja_qi_level;
 		JsonArray ja_qi_level_work = ja_qi_level.to<JsonArray>();
-		for(auto v: queued_interrupts[il])
+		for(auto v: queued[il])
 			ja_qi_level_work.add(v);
 
 		j_queued_interrupts[format("%d", il)] = ja_qi_level;
@@ -2781,6 +3426,8 @@ JsonDocument cpu::serialize()
 
 	j["any_queued_interrupts"] = bool(any_queued_interrupts);
 
+	j["fp11"]                  = fpu->serialize();
+
 	return j;
 }
 
@@ -2796,12 +3443,14 @@ cpu *cpu::deserialize(const JsonVariantConst j, bus *const b, kek_event_t *const
 	for(int spnr=0; spnr<4; spnr++)
 		c->sp[spnr] = j[format("sp-%d", spnr)];
 
-        c->pc                    = j["pc"];
         c->psw                   = j["psw"];
-        c->fpsr                  = j["fpsr"];
+        c->load_active_registers();
+        c->setPC(j["pc"]);
+        c->fpu->set_fps(j["fpsr"]);
         c->stack_limit_register  = j["stack_limit_register"];
         c->processing_trap_depth = j["processing_trap_depth"];
         c->instructions_executed = j["instructions_executed"];
+	c->event_time_offset     = 0 - c->instructions_executed;  // the scheduler is new: start at 0
 
 	if (j.containsKey("delayed_trap"))
 		c->delayed_trap  = j["delayed_trap"];
@@ -2810,13 +3459,50 @@ cpu *cpu::deserialize(const JsonVariantConst j, bus *const b, kek_event_t *const
 
 	c->any_queued_interrupts = j["any_queued_interrupts"].as<bool>();
 
+	if (j.containsKey("fp11"))
+		c->fpu->deserialize(j["fp11"]);
+
 	c->init_interrupt_queue();
 	for(int level=0; level<8; level++) {
 		JsonArrayConst ja_qi_level = j["queued_interrupts"][format("%d", level)].as<JsonArrayConst>();
 		for(auto v : ja_qi_level)
-			c->queued_interrupts[level].insert(v.as<int>());
+			c->queue_interrupt(level, v.as<int>());
 	}
 
 	return c;
 }
 #endif
+
+#if defined(UNIT_TEST)
+#include <gtest/gtest.h>
+
+TEST(cpu, interrupt_vectors) {
+	bus  b;
+	kek_event_t event { 0 };
+	cpu *c = new cpu(&b, &event);
+	b.add_cpu(c);
+
+	// the DEQNA vector is programmed by the guest and can be above 01000
+	c->queue_interrupt(4, 01774);
+	c->queue_interrupt(4, 0120);
+	auto irqs = c->get_queued_interrupts()[4];
+	EXPECT_EQ(irqs.size(), 2);
+	EXPECT_EQ(irqs.count(01774), 1);
+	EXPECT_EQ(irqs.count(0120), 1);
+	EXPECT_EQ(c->check_if_interrupts_pending(), true);
+
+	c->unqueue_interrupt(4, 01774);
+	irqs = c->get_queued_interrupts()[4];
+	EXPECT_EQ(irqs.size(), 1);
+	EXPECT_EQ(irqs.count(0120), 1);
+
+	// out of range: ignored, not written outside of the table
+	c->queue_interrupt(4, 02000);
+	c->queue_interrupt(4, 0177774);
+	c->queue_interrupt(4, 0122);
+	c->queue_interrupt(8, 0120);
+	auto all = c->get_queued_interrupts();
+	for(int level=0; level<8; level++)
+		EXPECT_EQ(all[level].size(), level == 4 ? 1 : 0);
+}
+#endif
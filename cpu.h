@@ -4,10 +4,12 @@
 #pragma once
 
 #include "gen.h"
+#include "cpu_model.h"
 #if IS_POSIX
 #include <ArduinoJson.h>
 #endif
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <condition_variable>
 #include <mutex>
@@ -20,6 +22,11 @@
 
 class breakpoint;
 class bus;
+class event_scheduler;
+class fp11;
+class governor;
+class kw11_l;
+class memory;
 class mmu;
 
 constexpr const int      max_stacktrace_depth = 16;
@@ -27,6 +34,13 @@ constexpr const uint16_t B16_MSBSET = 0x8000;
 constexpr const uint32_t B32_MSBSET = 0x80000000;
 constexpr const uint32_t B32_MSWSET = 0xffff0000;
 constexpr const uint64_t B64_MSWSET = 0xffffffff00000000ll;
+constexpr const uint16_t irq_vector_end   = 02000;  // vectors a device can program (e.g. the DEQNA: 10 bits)
+constexpr const int      n_irq_slot_words = irq_vector_end / 4 / 32;
+constexpr const int      n_trap_vectors   = 01000 / 4;
+constexpr const int      idle_loop_max_words = 8;   // longest loop (in words) considered for idle detection
+constexpr const int      idle_loop_threshold = 64;  // identical iterations before the cpu thread parks
+constexpr const int      idle_park_ms        = 10;  // upper bound, wake_up() and interrupts end it earlier
+constexpr const uint32_t default_instructions_per_second = 1000000;  // for event timing without -K
 
 typedef struct {
 	word_mode_t    word_mode;
@@ -39,65 +53,137 @@ typedef struct {
 	};
 
 	uint16_t       value;
+
+	// physical address + page index of 'value' if it was read from RAM
+	// (not set for the I/O page); used by read-modify-write instructions
+	std::optional<std::pair<uint32_t, int> > physical;
 } gam_rc_t;
 
 class cpu
 {
 private:
+	uint16_t regs[8]            {       };  // active: R0...5 of the current set, SP of the current mode, PC
 	uint16_t regs0_5[2][6]; // R0...5, selected by bit 11 in PSW, 
 	uint16_t sp[3 + 1]; // stackpointers, MF../MT.. select via 12/13 from PSW, others via 14/15
-	uint16_t pc                 { 0     };
 	uint16_t psw                { 0     };
-	uint16_t fpsr               { 0     };
 	uint16_t stack_limit_register { 0400 };
 	int      processing_trap_depth { 0  };
 	std::optional<int> delayed_trap {   };  // invoked after completion of the instruction
 	int      kw11l_counter      { 0     };
 	bool     wait_stuck         { false };
 	uint64_t trap_counter       { 0     };
-	std::unordered_map<uint16_t, uint32_t> trap_counts;
+	// per run mode (at the moment of the trap) and vector / 4
+	std::array<std::array<uint32_t, n_trap_vectors>, 4> trap_counts { };
 	uint64_t instructions_executed { 0  };
+	// instructions_executed is reset and restored; the event time must never
+	// go back (pending events keep their absolute due time), see get_event_time()
+	uint64_t event_time_offset  { 0     };
 	uint16_t last_trap_vector   { 0     };
-
-	// vector, 8 levels
-	std::array<std::set<uint16_t>, 8> queued_interrupts;
-	abool        any_queued_interrupts { false };
+	// what MMR1/MMR2 would contain for the current instruction, see mmu::getMMR1()
+	uint16_t instruction_start  { 0     };
+	uint16_t MMR1_log           { 0     };
+	bool     allow_block_loops  { true  };  // see try_block_loop()
+	bool     block_loops_wanted { true  };  // allow_block_loops is off while the speed governor runs
+	bool     has_fpu            { true  };
+	bool     has_mxps           { false };  // MTPS/MFPS
+	bool     has_supervisor     { true  };  // else PSW modes are kernel or user only
+
+	// interrupt request table: per level a bitmap of vector slots (vector / 4,
+	// vectors are below irq_vector_end) and a summary with a bit per level that has
+	// something pending. updated with atomics, no lock involved.
+	// any_queued_interrupts makes step() look at it; set for a new request
+	// and when the priority drops below the highest pending level.
+	std::array<std::array<std::atomic_uint32_t, n_irq_slot_words>, 8> queued_interrupts;
+	std::atomic_uint8_t     pending_levels        { 0     };
+	abool                   any_queued_interrupts { false };
 #if defined(FREERTOS)
-	SemaphoreHandle_t       qi_lock { xSemaphoreCreateBinary() };
 	QueueHandle_t           qi_q    { xQueueCreate(16, 1)      };
 #else
+	// only used to wake up WAIT
 	std::mutex              qi_lock;
 	std::condition_variable qi_cv;
+	abool                   in_wait { false };
 #endif
+	abool                   idle_wakeup { false };  // see wake_up()
 
 	std::unordered_map<int, breakpoint *> breakpoints;
 	int                     bp_nr       { 0 };
 
-	bus *const b    { nullptr };
-	mmu *const mmu_ { nullptr };
+	bus  *const b    { nullptr };
+	mmu  *const mmu_ { nullptr };
+	fp11 *const fpu  { nullptr };
+	governor   *speed_governor { nullptr };
+
+	event_scheduler *const scheduler { nullptr };
+	uint32_t virtual_clock_ips  { 0          };  // see set_virtual_line_clock()
+
+	// translation of the code page that was fetched from last; valid as
+	// long as the run mode and the mmu mapping-generation do not change
+	struct {
+		uint16_t  start      { 1       };  // virtual range, inclusive
+		uint16_t  end        { 0       };
+		uint32_t  offset     { 0       };  // physical = offset + virtual
+		int       run_mode   { -1      };
+		uint32_t  generation { 0       };
+		memory   *m          { nullptr };
+	} fetch_cache;
+
+	// short loop ending in a backward branch that may be the guest idling
+	// (polling a device or "BR ."), see check_idle_loop()
+	struct {
+		uint16_t  start      { 1       };
+		uint16_t  end        { 0       };  // address of the branch
+		bool      rejected   { false   };  // does more than testing and branching
+		int       count      { 0       };  // iterations with the same registers and PSW
+		uint16_t  regs[8]    {         };
+		uint16_t  psw        { 0       };
+	} idle_loop;
 
 	kek_event_t *const event { nullptr };
 	console     *cnsl        { nullptr };
 
-	bool     check_pending_interrupts() const;  // needs the 'qi_lock'-lock
+	bool     check_pending_interrupts() const;
 	void     execute_any_pending_interrupt();
+	void     recheck_interrupts();
+	void     clear_pending_level_if_empty(const uint8_t level);
+	static bool is_valid_interrupt(const uint8_t level, const uint16_t vector);
+	void     check_idle_loop();
+	bool     is_idle_loop_body(const uint16_t start, const uint16_t end);
+	void     park_idle();
+	bool     skip_to_next_event();
 
 	uint32_t shifter(uint32_t value, int shift, bool is32b);
 
 	uint16_t add_register(const int nr, const uint16_t value);
+	bool     fetch_cache_hit(const uint16_t a, const int run_mode) const;
+	uint16_t fetch_word(const uint16_t a);
+	void     fill_fetch_cache(const uint16_t a, const int run_mode, const std::pair<uint32_t, int> & physical);
+	void     switch_register_banks(uint16_t new_psw);  // sets the PSW
+	void     load_active_registers();
 	void     add_to_MMR1(const int reg, const int delta);
 
+	template <uint8_t mode, word_mode_t word_mode>
+	gam_rc_t getGAM_mode(const uint8_t reg, const bool read_value);
+	template <word_mode_t word_mode>
+	gam_rc_t getGAM_wm(const uint8_t mode, const uint8_t reg, const bool read_value);
+	template <word_mode_t word_mode, bool is_register>
+	gam_rc_t get_operand(const uint8_t mode, const uint8_t reg, const bool read_value = true);
+
 	gam_rc_t getGAM(const uint8_t mode, const uint8_t reg, const word_mode_t word_mode, const bool read_value = true);
 	gam_rc_t getGAMAddress(const uint8_t mode, const int reg, const word_mode_t word_mode);
 	bool     putGAM(const gam_rc_t & g, const uint16_t value); // returns false when flag registers should not be updated
 
 	std::optional<bool> conditional_branch_instructions_evaluate(const uint16_t instr) const;
 	bool double_operand_instructions(const uint16_t instr);
+	template <word_mode_t word_mode, bool src_is_register, bool dst_is_register>
+	bool double_operand(const uint16_t instr);
 	bool additional_double_operand_instructions(const uint16_t instr);
 	bool single_operand_instructions(const uint16_t instr);
 	bool conditional_branch_instructions(const uint16_t instr);
 	bool condition_code_operations(const uint16_t instr);
 	bool misc_operations(const uint16_t instr);
+	void try_block_loop(const uint16_t instr);
+	void execute_block_loop(const uint16_t instr, const uint16_t sob);
 
 	struct operand_parameters {
 		std::string operand;
@@ -111,6 +197,8 @@ private:
 	operand_parameters addressing_to_string(const uint8_t mode_register, const uint16_t pc, const word_mode_t word_mode) const;
 	uint16_t peek_dst(const int mode, const int reg, const uint16_t pc, const word_mode_t word_mode) const;
 
+	friend class fp11;  // uses the addressing helpers
+
 public:
 	explicit cpu(bus *const b, kek_event_t *const event);
 	~cpu();
@@ -130,27 +218,50 @@ public:
 	void disassemble(void) const;
 	std::unordered_map<std::string, std::vector<std::string> > disassemble(const uint16_t addr) const;
 
-	bus *getBus() { return b; }
+	bus  *getBus() { return b;   }
+	void  set_cpu_model(const cpu_model_features_t & features);
+	fp11 *getFPU() { return fpu; }
 
 	void     reset();
 	bool     step ();
+	// off when every instruction must be seen separately (single stepping, tracing, breakpoints)
+	void     set_allow_block_loops(const bool allow) { block_loops_wanted = allow; allow_block_loops = allow && !speed_governor; }
+	// run at 'factor' times the speed of a real 11/70, or unlimited when not set
+	void     set_speed_factor(const std::optional<double> factor);
+	std::optional<double> get_speed_factor() const;
+	void     reset_speed_governor();  // e.g. when continuing after a pause
+	// tick the KW11-L every 1/Hz seconds of emulated time, at 'ips' instructions
+	// per second, instead of on the wall clock; reproducible and independent
+	// of the host speed
+	void     set_virtual_line_clock(const std::optional<uint32_t> ips);
+	std::optional<uint32_t> get_virtual_line_clock() const;
+
+	// device events, timed in instructions executed (plus what WAIT skipped)
+	event_scheduler *get_scheduler() { return scheduler; }
+	uint64_t get_event_time() const { return instructions_executed + event_time_offset; }
+	uint64_t us_to_event_time(const uint64_t us) const;  // emulated micro seconds
 
 	uint64_t get_instructions_executed_count() const { return instructions_executed; }
 	uint32_t calc_instruction_duration(const uint16_t pc) const;  // nanoseconds
 	uint64_t get_trap_counter() const { return trap_counter; }
-	auto     get_trap_counts() const { return trap_counts; }
+	std::array<uint32_t, n_trap_vectors> get_trap_counts(const int run_mode = -1) const;  // -1: all modes
 
 	void     push_stack(const uint16_t v);
 	uint16_t pop_stack();
 
+	uint16_t get_instruction_start() const { return instruction_start; }
+	uint16_t get_MMR1_log() const { return MMR1_log; }
+
 	void     reset_last_trap_vector() { last_trap_vector = 0; }
 	uint16_t get_last_trap_vector() const { return last_trap_vector; }
 
 	void init_interrupt_queue();
 	void queue_interrupt(const uint8_t level, const uint16_t vector);
 	void unqueue_interrupt(const uint8_t level, const uint16_t vector);
-	std::array<std::set<uint16_t>, 8> get_queued_interrupts() const { return queued_interrupts; }
+	std::array<std::set<uint16_t>, 8> get_queued_interrupts() const;
 	bool check_if_interrupts_pending() const { return any_queued_interrupts; }
+	// a device got input without queueing an interrupt or posted an event; ends idling and WAIT
+	void wake_up();
 
 	void trap(uint16_t vector, const int new_ipl = -1);
 
@@ -178,10 +289,10 @@ public:
 	uint16_t get_stack_limit_register() { return stack_limit_register; }
 	void     set_stack_limit_register(const uint16_t v) { stack_limit_register = v; }
 
-	uint16_t get_stackpointer(const int which) const { assert(which >= 0 && which < 4); return sp[which]; }
-	uint16_t getPC() const { return pc; }
-	void set_stackpointer(const int which, const uint16_t value) { assert(which >= 0 && which < 4); sp[which] = value; }
-	void setPC(const uint16_t value) { pc = value; }
+	uint16_t get_stackpointer(const int which) const { assert(which >= 0 && which < 4); return which == getPSW_runmode() ? regs[6] : sp[which]; }
+	uint16_t getPC() const { return regs[7]; }
+	void set_stackpointer(const int which, const uint16_t value) { assert(which >= 0 && which < 4); if (which == getPSW_runmode()) regs[6] = value; else sp[which] = value; }
+	void setPC(const uint16_t value) { regs[7] = value; }
 
 	void set_register(const int nr, const uint16_t value);
 	void set_registerLowByte(const int nr, const word_mode_t word_mode, const uint16_t value);
@@ -189,8 +300,8 @@ public:
 	void lowlevel_register_set(const uint8_t set, const uint8_t reg, const uint16_t value);
 	void lowlevel_register_sp_set(const uint8_t set, const uint16_t value);
 	uint16_t lowlevel_register_get(const uint8_t set, const uint8_t reg) const;
-	void lowlevel_psw_set(const uint16_t value) { psw = value; }
-	uint16_t lowlevel_register_sp_get(const uint8_t nr) const { return sp[nr]; }
+	void lowlevel_psw_set(const uint16_t value) { switch_register_banks(value); }
+	uint16_t lowlevel_register_sp_get(const uint8_t nr) const { return get_stackpointer(nr); }
 
 	uint16_t  get_register        (const int nr) const;
 	uint16_t *get_register_pointer(const int nr);
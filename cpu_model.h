@@ -0,0 +1,44 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include <optional>
+#include <string>
+
+
+typedef enum { cm_11_70, cm_11_45, cm_11_40, cm_11_34 } cpu_model_t;
+
+typedef struct {
+	cpu_model_t  model;
+	const char  *name;
+	bool         has_id_space;     // separate I/D space (MMR3 bits 0...2)
+	bool         has_22bit;        // 22 bit mapping + the other 11/70 system registers
+	bool         has_supervisor;   // supervisor mode PARs/PDRs
+	bool         has_cpuerr;       // CPU error register
+	bool         has_stack_limit;  // programmable stack limit (else fixed at 0400)
+	bool         has_pir;          // program interrupt request register
+	bool         has_fpu;          // FP11
+	bool         has_mxps;         // MTPS/MFPS instructions
+} cpu_model_features_t;
+
+// without supervisor mode, only kernel (00) and user (11) can be selected in
+// the PSW: the other mode values end up as user mode
+constexpr const cpu_model_features_t cpu_models[] {
+	//                      I/D    22b    super  cpuerr slr    pir    fpu    mxps
+	{ cm_11_70, "11/70", true,  true,  true,  true,  true,  true,  true,  false },
+	{ cm_11_45, "11/45", true,  false, true,  false, true,  true,  true,  false },
+	{ cm_11_40, "11/40", false, false, false, false, false, false, false, false },
+	{ cm_11_34, "11/34", false, false, false, false, false, false, true,  true  },
+};
+
+inline std::optional<cpu_model_t> find_cpu_model(const std::string & name)
+{
+	for(auto & m: cpu_models) {
+		// "11/70" or just "70"
+		if (name == m.name || name == m.name + 3)
+			return m.model;
+	}
+
+	return { };
+}
@@ -16,6 +16,7 @@
 #include "bus.h"
 #include "cpu.h"
 #include "dc11.h"
+#include "event_scheduler.h"
 #include "log.h"
 #include "utils.h"
 
@@ -33,7 +34,8 @@ static void thread_wrapper_dc11(void *p)
 
 dc11::dc11(bus *const b, comm_io *const io_channels):
 	b(b),
-	io_channels(io_channels)  // FIXME must be 4 elements
+	io_channels(io_channels),  // FIXME must be 4 elements
+	tx_flush(b, comm_tx_flush_us, [this] { this->io_channels->flush_all(); })
 {
 	connected.resize(4);
 }
@@ -42,7 +44,12 @@ dc11::~dc11()
 {
 	DOLOG(log_ss::LS_COMM, "DC11 closing");
 
+	io_channels->set_notifier(nullptr);
+
+	tx_flush.cancel();
+
 	stop_flag = true;
+	wake_up();
 
 	if (th) {
 		th->join();
@@ -69,6 +76,8 @@ FLASHMEM void dc11::show_state(console *const cnsl) const
 
 bool dc11::begin()
 {
+	io_channels->set_notifier([this] { wake_up(); });
+
 #if defined(ESP32) || defined(FREERTOS)
 	xTaskCreate(&thread_wrapper_dc11, "dc11", 3072, this, 1, nullptr);
 #else
@@ -98,6 +107,13 @@ void dc11::trigger_interrupt(const int line_nr, const bool is_tx)
 	b->getCpu()->queue_interrupt(5, 0300 + line_nr * 010 + 4 * is_tx);
 }
 
+// invoked by the comm backends, from their own thread
+void dc11::wake_up()
+{
+	if (rx_wakeup_pending.exchange(true) == false)
+		rx_wakeup.push(0);
+}
+
 void dc11::operator()()
 {
 	set_thread_name("kek:DC11");
@@ -105,7 +121,9 @@ void dc11::operator()()
 	DOLOG(log_ss::LS_COMM, "DC11 thread started");
 
 	while(!stop_flag) {
-		myusleep(10000);  // TODO replace polling
+		// backends that notify when something happened need not be polled
+		rx_wakeup.pop(io_channels->can_notify() ? dc11_idle_poll_ms : dc11_poll_ms);
+		rx_wakeup_pending = false;
 
 		for(size_t line_nr=0; line_nr<dc11_n_lines; line_nr++) {
 			my_unique_lock lck(&input_lock[line_nr]);
@@ -131,9 +149,12 @@ void dc11::operator()()
 
 			// receive data
 			bool have_data = false;
-			while(io_channels->has_data(line_nr)) {
-				uint8_t buffer = io_channels->get_byte(line_nr);
-				recv_buffers[line_nr].push_back(char(buffer));
+			for(;;) {
+				uint8_t buffer[512];
+				size_t  n = io_channels->get_bytes(line_nr, buffer, sizeof buffer);
+				if (n == 0)
+					break;
+				recv_buffers[line_nr].insert(recv_buffers[line_nr].end(), buffer, buffer + n);
 				have_data = true;
 			}
 
@@ -142,6 +163,8 @@ void dc11::operator()()
 
 				if (is_rx_interrupt_enabled(line_nr))
 					trigger_interrupt(line_nr, false);
+				else
+					b->getCpu()->wake_up();
 			}
 		}
 	}
@@ -153,6 +176,17 @@ void dc11::reset(const bool)
 {
 }
 
+void dc11::transmit(const int line_nr, const uint8_t ch)
+{
+	io_channels->queue_data(line_nr, ch);
+	tx_flush.written();
+}
+
+void dc11::flush_tx()
+{
+	tx_flush.flush_now();
+}
+
 bool dc11::is_rx_interrupt_enabled(const int line_nr) const
 {
 	return !!(registers[line_nr * 4 + 0] & 64);
@@ -199,6 +233,8 @@ uint16_t dc11::read_word(const uint16_t addr)
 		registers[line_nr * 4 + 0] &= ~0160000;
 	}
 	else if (sub_reg == 1) {  // read data register
+		flush_tx();
+
 		DOLOG(log_ss::LS_COMM, "DC11: %" PRIzu " characters in buffer for line %d", recv_buffers[line_nr].size(), line_nr);
 
 		// get oldest byte in buffer
@@ -209,7 +245,7 @@ uint16_t dc11::read_word(const uint16_t addr)
 			registers[line_nr * 4 + 0] &= ~(1 << 5);
 			registers[line_nr * 4 + 0] |= parity(vtemp) << 5;
 
-			recv_buffers[line_nr].erase(recv_buffers[line_nr].begin());
+			recv_buffers[line_nr].pop_front();
 
 			// still data in buffer? generate interrupt
 			if (recv_buffers[line_nr].empty() == false) {
@@ -272,7 +308,7 @@ void dc11::write_word(const uint16_t addr, const uint16_t v)
 		else
 			DOLOG(log_ss::LS_COMM, "DC11: transmit %c on line %d", c, line_nr);
 
-		io_channels->send_data(line_nr, reinterpret_cast<const uint8_t *>(&c), 1);
+		transmit(line_nr, c);
 
 		if (is_tx_interrupt_enabled(line_nr))
 			trigger_interrupt(line_nr, true);
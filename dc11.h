@@ -4,6 +4,7 @@
 #pragma once
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <thread>
 #include <vector>
 
@@ -13,6 +14,7 @@
 #include "bus.h"
 #include "log.h"
 #include "my_lock.h"
+#include "tx_flush_timer.h"
 
 #define DC11_RCSR 0174000 // receiver status register
 #define DC11_BASE DC11_RCSR
@@ -22,6 +24,8 @@ class bus;
 
 // 4 interfaces
 constexpr const int dc11_n_lines = 4;
+constexpr const int dc11_poll_ms      = 10;    // when one or more backends cannot notify
+constexpr const int dc11_idle_poll_ms = 1000;  // only as a fall-back
 
 class dc11: public device
 {
@@ -34,10 +38,18 @@ private:
 	comm_io          *const io_channels { nullptr };
 	std::vector<bool> connected;
 
-	std::vector<char> recv_buffers[dc11_n_lines];
+	std::deque<char>  recv_buffers[dc11_n_lines];
         mutable my_lock   input_lock  [dc11_n_lines];
 
+	my_threadsafe_queue<int> rx_wakeup;  // the comm backends have news
+	abool             rx_wakeup_pending { false  };
+
+	tx_flush_timer    tx_flush;  // sends what queue_data() buffered
+
 	void trigger_interrupt(const int line_nr, const bool is_tx);
+	void wake_up();
+	void transmit(const int line_nr, const uint8_t ch);
+	void flush_tx();
 	bool is_rx_interrupt_enabled(const int line_nr) const;
 	bool is_tx_interrupt_enabled(const int line_nr) const;
 
@@ -21,6 +21,8 @@
 #include "bus.h"
 #if IS_POSIX
 #include "comm_posix_tty.h"
+#include "comm_pty.h"
+#include "comm_unix_socket.h"
 #endif
 #if !defined(BUILD_FOR_PICO2W) && !defined(TEENSY4_1)
 #include "comm_tcp_socket_client.h"
@@ -284,7 +286,7 @@ FLASHMEM void configure_comm(console *const cnsl, comm_io *const device_list)
 
 		size_t device_nr = ch_dev - 'A';
 
-		int  ch_opt = wait_for_key("1. TCP client, 2. TCP server, 3. serial device, 4. SC16IS752, 5. PST emulation, 9. to abort", cnsl, { '1', '2', '3', '4', '5', '9' });
+		int  ch_opt = wait_for_key("1. TCP client, 2. TCP server, 3. serial device, 4. SC16IS752, 5. PST emulation, 6. unix domain socket, 7. pty, 9. to abort", cnsl, { '1', '2', '3', '4', '5', '6', '7', '9' });
 		bool rc     = false;
 
 		if (false) {
@@ -349,6 +351,21 @@ FLASHMEM void configure_comm(console *const cnsl, comm_io *const device_list)
 			rc = device_list->set_device(device_nr, new comm_pst("-"));
 #endif
 		}
+		else if (ch_opt == '6' || ch_opt == '7') {
+#if IS_POSIX
+			if (ch_opt == '6') {
+				std::string temp = cnsl->read_line("path: ");
+				if (temp.empty() == false)
+					rc = device_list->set_device(device_nr, new comm_unix_socket(temp));
+			}
+			else {
+				std::string temp = cnsl->read_line("symlink to create (optional): ");
+				rc = device_list->set_device(device_nr, new comm_pty(temp));
+			}
+#else
+			cnsl->put_string_lf("Not implemented yet on this platform");
+#endif
+		}
 
 		if (ch_opt != 9 && rc == false)
 			cnsl->put_string_lf("Failed to initialize device");
@@ -641,9 +658,14 @@ FLASHMEM void show_cpu_state(console *const cnsl, cpu *const c)
 			cnsl->put_string_lf("");
 		}
 	}
-	std::unordered_map<uint16_t, uint32_t> trap_counts = c->get_trap_counts();
-	for(auto & vector: trap_counts)
-		cnsl->put_string_lf(format("vector %06o count: %u", vector.first, vector.second));
+	auto trap_counts_k = c->get_trap_counts(0);
+	auto trap_counts_s = c->get_trap_counts(1);
+	auto trap_counts_u = c->get_trap_counts(3);
+	for(int i=0; i<n_trap_vectors; i++) {
+		uint32_t total = trap_counts_k[i] + trap_counts_s[i] + trap_counts_u[i];
+		if (total)
+			cnsl->put_string_lf(format("vector %06o count: %u (kernel: %u, supervisor: %u, user: %u)", i * 4, total, trap_counts_k[i], trap_counts_s[i], trap_counts_u[i]));
+	}
 	cnsl->put_string_lf(format("stack limit register: %06o", c->get_stack_limit_register()));
 }
 
@@ -1090,6 +1112,25 @@ FLASHMEM cmd_rc cmd_turbo(console *const cnsl, const std::vector<std::string> &,
 	return debugger_continue;
 }
 
+FLASHMEM cmd_rc cmd_speed(console *const cnsl, const std::vector<std::string> & parts, bus *const, cpu *const c, debugger_state *const, kek_event_t *const)
+{
+	if (parts.size() == 2) {
+		double factor = std::stod(parts[1]);
+		if (factor > 0)
+			c->set_speed_factor(factor);
+		else
+			c->set_speed_factor({ });
+	}
+
+	auto factor = c->get_speed_factor();
+	if (factor.has_value())
+		cnsl->put_string_lf(format("Speed: %.2fx a PDP-11/70", factor.value()));
+	else
+		cnsl->put_string_lf("Speed: unlimited");
+
+	return debugger_continue;
+}
+
 FLASHMEM cmd_rc cmd_state(console *const cnsl, const std::vector<std::string> & parts, bus *const b, cpu *const c, debugger_state *const, kek_event_t *const)
 {
 	if (parts.size() == 1)
@@ -1681,6 +1722,7 @@ constexpr const cmd_pair cmd_pairs[] {
 	{ "setsl", "hostname", "set syslog target", cmd_setsl, cmd_pair::par_yes },
 	{ "pts", "setting", "enable (1) / disable (0) timestamps", cmd_pts, cmd_pair::par_yes },
 	{ "turbo", "", "toggle turbo mode (cannot be interrupted)", cmd_turbo, cmd_pair::par_no },
+	{ "speed", "[x]", "run at x times the speed of a real 11/70 (0: unlimited)", cmd_speed, cmd_pair::par_optional },
 	{ "state", "[reset [hard]] x", "dump state of (or reset) a device: rl02, rk05, rp06, rp07, mmu, tm11, kw11l, cpu, dc11, dz11 or deqna", cmd_state, cmd_pair::par_yes },
 	{ "mmures", "x", "resolve a virtual address", cmd_mmures, cmd_pair::par_yes },
 	{ "qi", "", "show queued interrupts", cmd_qi, cmd_pair::par_no },
@@ -1817,6 +1859,9 @@ bool emulation_do(console *const cnsl, bus *const b, cpu *const c, debugger_stat
 {
 	*cnsl->get_running_flag() = true;
 
+	c->set_allow_block_loops(state->turbo);  // else breakpoints etc. are checked for every instruction
+	c->reset_speed_governor();
+
 	if (state->turbo) {
 		while(load_relaxed_p(stop_event) == EVENT_NONE)
 			c->step();
@@ -1829,7 +1874,7 @@ bool emulation_do(console *const cnsl, bus *const b, cpu *const c, debugger_stat
 		uint64_t took                = 0;
 		uint64_t start_trap_count    = c->get_trap_counter();
 		bool     is_trace_enabled    = trace_enabled();
-		std::unordered_map<uint16_t, uint32_t> trap_counts_before = c->get_trap_counts();
+		auto     trap_counts_before  = c->get_trap_counts();
 		while(load_relaxed_p(stop_event) == EVENT_NONE) {
 			if (state->trap_trace_trigger.has_value() && state->trap_trace_trigger.value() == c->get_last_trap_vector()) {
 				DOLOG(log_ss::LS_CPU, "Trap trace triggered");
@@ -1895,7 +1940,7 @@ bool emulation_do(console *const cnsl, bus *const b, cpu *const c, debugger_stat
 				break;
 		}
 		uint64_t end_trap_count = c->get_trap_counter();
-		std::unordered_map<uint16_t, uint32_t> trap_counts_after = c->get_trap_counts();
+		auto     trap_counts_after = c->get_trap_counts();
 
 		if (state->pc_monitor_enabled) {
 			std::map<int, std::pair<uint16_t, uint32_t> > ordered;
@@ -1920,18 +1965,18 @@ bool emulation_do(console *const cnsl, bus *const b, cpu *const c, debugger_stat
 						(get_us() - since) / 1000000.,
 						wait_count > 0 ? total_wait_duration / double(wait_count) : 0,
 					size_t(end_trap_count - start_trap_count)));
-			for(auto & trap : trap_counts_after) {
-				uint32_t cnt = trap.second; 
-				auto     it  = trap_counts_before.find(trap.first);
-				if (it != trap_counts_before.end())
-					cnt -= it->second;
-				cnsl->put_string_lf(format("trap vec %06o: %u", trap.first, cnt));
+			for(int i=0; i<n_trap_vectors; i++) {
+				uint32_t cnt = trap_counts_after[i] - trap_counts_before[i];
+				if (cnt)
+					cnsl->put_string_lf(format("trap vec %06o: %u", i * 4, cnt));
 			}
 		}
 
 		state->pc_monitor_enabled = false;
 	}
 
+	cnsl->flush_output();  // what the guest printed last may still be buffered
+
 	*cnsl->get_running_flag() = false;
 
 	return true;
@@ -2018,6 +2063,8 @@ FLASHMEM void simple_run(console *const cnsl, bus *const b, kek_event_t *const s
 	cpu  *const c = b->getCpu();
 	bool        t = trace_enabled();
 
+	c->set_allow_block_loops(!t);
+
 	*cnsl->get_running_flag() = true;
 
 	while(*stop_event == EVENT_NONE) {
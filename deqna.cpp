@@ -4,7 +4,10 @@
 #include <cstring>
 #include <unistd.h>
 
+#include "bus.h"
+#include "cpu.h"
 #include "deqna.h"
+#include "event_scheduler.h"
 #include "log.h"
 #include "utils.h"
 
@@ -12,17 +15,10 @@
 constexpr const uint8_t bc_addr[] { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
 
 #if defined(FREERTOS)
-static void thread_wrapper_receiver_low(void *p)
+static void thread_wrapper_receiver(void *p)
 {
 	deqna *const deqna_ = reinterpret_cast<deqna *>(p);
-	deqna_->receiver_low();
-	vTaskDelete(nullptr);
-}
-
-static void thread_wrapper_receiver_high(void *p)
-{
-	deqna *const deqna_ = reinterpret_cast<deqna *>(p);
-	deqna_->receiver_high();
+	deqna_->receiver();
 	vTaskDelete(nullptr);
 }
 #endif
@@ -39,11 +35,9 @@ deqna::deqna(bus *const b, const uint8_t mac_address[6], eth_transport *const et
 bool deqna::begin()
 {
 #if defined(FREERTOS)
-	xTaskCreate(&thread_wrapper_receiver_low,  "deqna-rl", 1024, this, 1, nullptr);
-	xTaskCreate(&thread_wrapper_receiver_high, "deqna-rh", 1024, this, 1, nullptr);
+	xTaskCreate(&thread_wrapper_receiver, "deqna-rx", 1024, this, 1, nullptr);
 #else
-	th_rx_low  = new std::thread(&deqna::receiver_low,  this);
-	th_rx_high = new std::thread(&deqna::receiver_high, this);
+	th_rx = new std::thread(&deqna::receiver, this);
 #endif
 	return true;
 }
@@ -52,18 +46,17 @@ deqna::~deqna()
 {
 	stop_flag = true;
 #if defined(FREERTOS)
-	while(rx_low_stopped == false || rx_high_stopped == false)
+	while(rx_stopped == false)
 		vTaskDelay(1 / portTICK_PERIOD_MS);
 #else
-	if (th_rx_low) {
-		th_rx_low->join();
-		delete th_rx_low;
-	}
-	if (th_rx_high) {
-		th_rx_high->join();
-		delete th_rx_high;
+	if (th_rx) {
+		th_rx->join();
+		delete th_rx;
 	}
 #endif
+	if (rx_event && b->getCpu())
+		b->getCpu()->get_scheduler()->cancel(rx_event);
+
 	purge_buffers();
 	delete eth_dev;
 }
@@ -73,21 +66,64 @@ void deqna::purge_buffers()
 	while(received.is_empty() == false) {
 		auto item = received.pop(1000);
 		if (item.has_value())
-			delete [] item.value().first;
+			eth_dev->release(item.value());
 	}
 }
 
-void deqna::queue_rx_packet(const uint8_t *const in, const size_t n)
+// how many frames can still be queued. the receiver never asks the
+// transport for more, so that a batch does not overflow the queue.
+size_t deqna::get_rx_queue_room() const
 {
-	if (received.aprox_size() < DEQNA_MAX_N_QUEUED) {
-		uint8_t *copy = new uint8_t[n];
-		memcpy(copy, in, n);
-		received.push({ copy, n });
+	size_t queued = received.aprox_size();
+
+	return queued < DEQNA_MAX_N_QUEUED ? DEQNA_MAX_N_QUEUED - queued : 0;
+}
+
+// takes ownership of the frames
+void deqna::queue_rx_frames(eth_frame *const *const frames, const size_t n)
+{
+	size_t queued = received.aprox_size();
+	size_t n_fit  = std::min(n, get_rx_queue_room());
+
+	received.push_all(frames, n_fit);
+
+	if (queued + n_fit > rx_queue_max)
+		rx_queue_max = queued + n_fit;
+
+	if (n_fit < n) {
+		DOLOG(log_ss::LS_DEQNA, "deqna: rx queue full, %" PRIzu " packet(s) dropped", n - n_fit);
+		eth_dev->release(&frames[n_fit], n - n_fit);
+		total_n_rx_drop += n - n_fit;
 	}
-	else {
-		DOLOG(log_ss::LS_DEQNA, "deqna: rx queue full, packet dropped");
+
+	if (n_fit)
+		schedule_rx_dma();
+}
+
+// the frames are put in guest memory by the cpu thread, between two
+// instructions. one event for whatever is queued at that moment.
+void deqna::schedule_rx_dma()
+{
+	if (rx_event_pending.exchange(true))
+		return;
+
+	cpu *const c = b->getCpu();
+	rx_event = c->get_scheduler()->schedule(0, [this] { rx_dma(); });  // 0: due right away
+	c->wake_up();  // in case it is in WAIT
+}
+
+void deqna::queue_rx_packet(const uint8_t *const in, const size_t n)
+{
+	eth_frame *f = n <= eth_max_frame_size ? eth_dev->get_pool()->get() : nullptr;
+	if (!f) {
+		DOLOG(log_ss::LS_DEQNA, "deqna: no frame buffer for %" PRIzu " bytes, packet dropped", n);
 		total_n_rx_drop++;
+		return;
 	}
+
+	memcpy(f->data, in, n);
+	f->n = n;
+	queue_rx_frames(&f, 1);
 }
 
 FLASHMEM void dump_packet(console *const cnsl, const uint8_t *const data, const size_t n_bytes, const bool full)
@@ -105,143 +141,191 @@ FLASHMEM void dump_packet(console *const cnsl, const uint8_t *const data, const
 	cnsl->put_string_lf(out);
 }
 
-// receiver pushes packets on a queue and signals another thread
-// to process it. this allows loopback
-void deqna::receiver_low()
+// receiver pushes packets on a queue, the cpu thread processes them
+// (see rx_dma()). this allows loopback
+void deqna::receiver()
 {
-	set_thread_name("deqna:rx_low");
-	DOLOG(log_ss::LS_DEQNA, "deqna(rxl) LOW RECEIVER THREAD starting");
+	set_thread_name("deqna:rx");
+	DOLOG(log_ss::LS_DEQNA, "deqna(rx) RECEIVER THREAD starting");
+
+	eth_frame *frames[eth_rx_batch_size] { };
+	bool       stalled = false;
 
 	while(!stop_flag) {
-		auto pkt = eth_dev->get(100);
-		if (pkt.first == nullptr)
+		// queue full? then leave the frames at the host (socket buffer)
+		// until the guest has processed some: that is better than dropping
+		size_t room = get_rx_queue_room();
+		if (room == 0) {
+			if (!stalled) {
+				stalled = true;
+				total_n_rx_stall++;
+			}
+
+			rx_room.pop(100);
+			rx_room_pending = false;
 			continue;
+		}
 
-		if (monitor_mode == everything)
-			dump_packet(cnsl, pkt.first, pkt.second, true);
+		stalled = false;
 
-		if (pkt.second < 14) {
-			DOLOG(log_ss::LS_DEQNA, "deqna(rxl) packet too short (%zu)", pkt.second);
-			delete [] pkt.first;
+		size_t n = eth_dev->get(frames, std::min(eth_rx_batch_size, room), 100);
+		if (n == 0)
 			continue;
-		}
 
-		// only for us or broadcast
-		if (memcmp(pkt.first, mac_address, 6) == 0 || memcmp(pkt.first, bc_addr, 6) == 0) {
-			if (registers[7] & 1) {  // receiver enabled?
-				if (monitor_mode == filtered)
-					dump_packet(cnsl, pkt.first, pkt.second, false);
-				total_n_rx_pkts++;
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxl) packet received from real Ethernet");
-				queue_rx_packet(pkt.first, pkt.second);
+		// the ones that are accepted are moved to the front, the rest goes
+		// back to the pool
+		size_t n_accepted = 0;
+
+		for(size_t i=0; i<n; i++) {
+			eth_frame *const pkt = frames[i];
+
+			if (monitor_mode == everything)
+				dump_packet(cnsl, pkt->data, pkt->n, true);
+
+			if (pkt->n < 14) {
+				DOLOG(log_ss::LS_DEQNA, "deqna(rx) packet too short (%" PRIzu ")", pkt->n);
+				eth_dev->release(pkt);
+				continue;
 			}
-			else {
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxl) dropped packet from %02x:%02x:%02x:%02x:%02x:%02x: receiver not enabled",
-						pkt.first[6], pkt.first[7],  pkt.first[8],
-						pkt.first[9], pkt.first[10], pkt.first[11]);
+
+			// only for us or broadcast
+			if (memcmp(pkt->data, mac_address, 6) == 0 || memcmp(pkt->data, bc_addr, 6) == 0) {
+				if (rx_enabled) {
+					if (monitor_mode == filtered)
+						dump_packet(cnsl, pkt->data, pkt->n, false);
+					total_n_rx_pkts++;
+					DOLOG(log_ss::LS_DEQNA, "deqna(rx) packet received from real Ethernet");
+					frames[n_accepted++] = pkt;
+					continue;
+				}
+
+				DOLOG(log_ss::LS_DEQNA, "deqna(rx) dropped packet from %02x:%02x:%02x:%02x:%02x:%02x: receiver not enabled",
+						pkt->data[6], pkt->data[7],  pkt->data[8],
+						pkt->data[9], pkt->data[10], pkt->data[11]);
 				total_n_rx_drop++;
 			}
+
+			eth_dev->release(pkt);
 		}
-		delete [] pkt.first;
+
+		queue_rx_frames(frames, n_accepted);
 	}
 
 #if defined(FREERTOS)
-	rx_low_stopped = true;
+	rx_stopped = true;
 #endif
 
-	DOLOG(log_ss::LS_DEQNA, "deqna(rxl) LOW RECEIVER THREAD TERMINATING");
+	DOLOG(log_ss::LS_DEQNA, "deqna(rx) RECEIVER THREAD TERMINATING");
 }
 
-void deqna::receiver_high()
+// invoked by the cpu thread (an event_scheduler event): nothing else
+// touches the registers or guest memory meanwhile
+void deqna::rx_dma()
 {
-	set_thread_name("deqna:rx_high");
-	DOLOG(log_ss::LS_DEQNA, "deqna(rxh) HIGH RECEIVER THREAD starting");
+	rx_event_pending = false;  // frames that are queued from now on, get a new event
 
-	bool invalid_list_shown = false;
-	while(!stop_flag) {
-		// receive list invalid?
+	size_t n_done = 0;
+	while(received.is_empty() == false) {
+		// receive list invalid? then the frames wait in the queue
 		if (registers[7] & 32) {
-			if (!invalid_list_shown) {
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxh): receive list invalid");
-				invalid_list_shown = true;
-			}
-			myusleep(received.is_empty() ? 10000 : 1000);
-			continue;
+			DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): receive list invalid");
+			break;
 		}
 
-		invalid_list_shown = false;
+		if (find_rx_descriptor() == false)
+			break;
 
-		auto item = received.pop(100);
+		auto item = received.pop(0);
 		if (item.has_value() == false)
-			continue;
+			break;
 
-		*activity_flag = true;
-
-		const uint8_t *const buffer   = item.value().first;
-		const size_t         byte_cnt = item.value().second;
-
-		DOLOG(log_ss::LS_DEQNA, "deqna(rxh): Ethernet packet received (%" PRIzu " bytes, from %02x:%02x:%02x:%02x:%02x:%02x, type: %04x)",
-				byte_cnt,
-				buffer[6], buffer[7], buffer[8], buffer[9], buffer[10], buffer[11], (buffer[12] << 8) | buffer[13]);
-
-		uint32_t p_buffers = ((registers[3] & 63) << 16) | registers[2];
-		DOLOG(log_ss::LS_DEQNA, "deqna(rxh): RBL is at %08o", p_buffers);
-
-		// push into pdp memory
-		bool     queued    = false;
-		// a descriptor is 6 words
-		while(p_buffers + 12 <= b->get_memory_size()) {
-			auto     ph    = b->read_unibus_word(p_buffers + 1 * 2);
-			auto     pl    = b->read_unibus_word(p_buffers + 2 * 2);
-			uint32_t chain = ((ph & 63) << 16) | pl;
-			auto     len   = b->read_unibus_word(p_buffers + 3 * 2);  // buffer length, 2s complement
-			int      length = ((~len & 0xffff) + 1) * 2;
-			if ((ph & 0x8000) == 0) {  // valid?
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxh): %08o is an end maker", p_buffers);
-				break;
-			}
-			if ((ph & 0x4000) == 0) {  // chain? no, use as buffer
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxh): flags: %06o, ph: %06o, status1: %06o, status2: %06o", b->read_unibus_word(p_buffers + 0 * 2), ph, b->read_unibus_word(p_buffers + 4 * 2), b->read_unibus_word(p_buffers + 5 * 2));
-				DOLOG(log_ss::LS_DEQNA, "deqna(rxh): %08o is not a chain pointer, use as buffer-pointer (%d bytes)", chain, length);
-				b->write_unibus_word(p_buffers + 0 * 2, 0xffff);  // processing
-				for(size_t i=0; i<std::min(byte_cnt, size_t(length)); i++)
-					b->write_unibus_byte(chain + i, buffer[i]);
-
-				size_t temp = std::max(byte_cnt, size_t(60)) - 60;  // frames are padded
-				b->write_unibus_word(p_buffers + 4 * 2, (temp & 0x0700) | 0x00f8);  // FIXME odd byte count
-				b->write_unibus_word(p_buffers + 5 * 2, ((temp & 0xff) << 8) | (temp & 0xff));  // mirrored
-				b->write_unibus_word(p_buffers + 0 * 2, 0x0200 | 0x0100);  // processed
-				b->write_unibus_word(p_buffers + 1 * 2, 0);
-				registers[7] |= 0x8000;  // RI
-				if (registers[7] & 64) {  // IE
-					uint16_t vector = registers[6] & 0x3fc;
-					DOLOG(log_ss::LS_DEQNA, "deqna(rxh): packet queued, trigger %06o", vector);
-					b->getCpu()->queue_interrupt(DEQNA_IRQ_LEVEL, vector);
-					queued = true;
-				}
-				break;
-			}
-			if (ph & 0x4000)
-				p_buffers = chain;
-			else
-				p_buffers += 12;
-		}
+		put_rx_frame(item.value());
+		eth_dev->release(item.value());
+		n_done++;
+	}
+
+	if (n_done == 0)
+		return;
+
+	if (rx_room_pending.exchange(true) == false)
+		rx_room.push(0);
+
+	*activity_flag = true;
+
+	if (received.is_empty() == false)
+		DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): %" PRIzu " packet(s) wait for receive buffers", received.aprox_size());
+
+	// one interrupt for the whole batch
+	registers[7] |= 0x8000;  // RI
+	if (registers[7] & 64) {  // IE
+		uint16_t vector = registers[6] & 0x3fc;
+		DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): %" PRIzu " packet(s) queued, trigger %06o", n_done, vector);
+		b->getCpu()->queue_interrupt(DEQNA_IRQ_LEVEL, vector);
+		total_n_rx_irqs++;
+	}
+}
 
-		delete [] buffer;
+// lets rx_desc point to a buffer descriptor, false (and "receive list
+// invalid") at the end of the list
+bool deqna::find_rx_descriptor()
+{
+	DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): RBL is at %08o", rx_desc);
+
+	// a descriptor is 6 words. this runs in the cpu thread: a chain that
+	// loops (e.g. to itself) must not hang the emulator, so follow at most
+	// as many chain pointers as there are descriptors in memory
+	uint32_t n_chain_left = b->get_memory_size() / 12;
 
-		registers[7] |= 32;
+	while(rx_desc + 12 <= b->get_memory_size()) {
+		auto     ph    = b->read_unibus_word(rx_desc + 1 * 2);
+		if ((ph & 0x8000) == 0) {  // valid?
+			DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): %08o is an end maker", rx_desc);
+			break;
+		}
+		if ((ph & 0x4000) == 0)  // chain? no, use as buffer
+			return true;
 
-		if (!queued) {
-			total_n_rx_drop++;
-			DOLOG(log_ss::LS_DEQNA, "deqna(rxh): packet NOT queued");
+		if (n_chain_left-- == 0) {
+			DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): chain at %08o loops", rx_desc);
+			break;
 		}
+
+		rx_desc = ((ph & 63) << 16) | b->read_unibus_word(rx_desc + 2 * 2);
 	}
 
-#if defined(FREERTOS)
-	rx_high_stopped = true;
-#endif
+	// the guest needs to give a new list
+	registers[7] |= 32;
+
+	return false;
+}
 
-	DOLOG(log_ss::LS_DEQNA, "deqna(rxh) HIGH RECEIVER THREAD TERMINATING");
+// rx_desc must point to a buffer descriptor, see find_rx_descriptor()
+void deqna::put_rx_frame(const eth_frame *const frame)
+{
+	const uint8_t *const buffer   = frame->data;
+	const size_t         byte_cnt = frame->n;
+
+	DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): Ethernet packet received (%" PRIzu " bytes, from %02x:%02x:%02x:%02x:%02x:%02x, type: %04x)",
+			byte_cnt,
+			buffer[6], buffer[7], buffer[8], buffer[9], buffer[10], buffer[11], (buffer[12] << 8) | buffer[13]);
+
+	auto     ph    = b->read_unibus_word(rx_desc + 1 * 2);
+	auto     pl    = b->read_unibus_word(rx_desc + 2 * 2);
+	uint32_t chain = ((ph & 63) << 16) | pl;
+	auto     len   = b->read_unibus_word(rx_desc + 3 * 2);  // buffer length, 2s complement
+	int      length = ((~len & 0xffff) + 1) * 2;
+
+	DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): flags: %06o, ph: %06o, status1: %06o, status2: %06o", b->read_unibus_word(rx_desc + 0 * 2), ph, b->read_unibus_word(rx_desc + 4 * 2), b->read_unibus_word(rx_desc + 5 * 2));
+	DOLOG(log_ss::LS_DEQNA, "deqna(rxdma): %08o is not a chain pointer, use as buffer-pointer (%d bytes)", chain, length);
+	b->write_unibus_block(chain, buffer, std::min(byte_cnt, size_t(length)));
+
+	size_t temp = std::max(byte_cnt, size_t(60)) - 60;  // frames are padded
+	b->write_unibus_word(rx_desc + 4 * 2, (temp & 0x0700) | 0x00f8);  // FIXME odd byte count
+	b->write_unibus_word(rx_desc + 5 * 2, ((temp & 0xff) << 8) | (temp & 0xff));  // mirrored
+	b->write_unibus_word(rx_desc + 0 * 2, 0x0200 | 0x0100);  // processed
+	b->write_unibus_word(rx_desc + 1 * 2, 0);
+
+	rx_desc += 12;
 }
 
 void deqna::transmitter()
@@ -370,6 +454,7 @@ FLASHMEM void deqna::reset(const bool hard)
 			16 |  // transmit list invalid
 			32 |  // receive list invalid
 			0x1000;  // power ok
+		rx_enabled = true;
 	}
 
 	purge_buffers();
@@ -378,11 +463,13 @@ FLASHMEM void deqna::reset(const bool hard)
 FLASHMEM void deqna::show_state(console *const cnsl) const
 {
 	cnsl->put_string_lf(format("MAC: %02x:%02x:%02x:%02x:%02x:%02x", mac_address[0], mac_address[1], mac_address[2], mac_address[3], mac_address[4], mac_address[5]));
-	cnsl->put_string_lf(format("%" PRIzu " packets queued", received.aprox_size()));
+	cnsl->put_string_lf(format("%" PRIzu " packets queued (max. %d, highest: %" PRIu64 ")", received.aprox_size(), int(DEQNA_MAX_N_QUEUED), uint64_t(rx_queue_max)));
 	for(int i=0; i<8; i++)
 		cnsl->put_string_lf(format("reg %d: %06o", i, uint16_t(registers[i])));
 	cnsl->put_string_lf(format("rx total  : %6" PRIu64, uint64_t(total_n_rx_pkts)));
 	cnsl->put_string_lf(format("rx dropped: %6" PRIu64, uint64_t(total_n_rx_drop)));
+	cnsl->put_string_lf(format("rx stalled: %6" PRIu64, uint64_t(total_n_rx_stall)));
+	cnsl->put_string_lf(format("rx irqs   : %6" PRIu64, uint64_t(total_n_rx_irqs)));
 	cnsl->put_string_lf(format("tx total  : %6" PRIu64, uint64_t(total_n_tx_pkts)));
 	cnsl->put_string_lf(format("tx dropped: %6" PRIu64, uint64_t(total_n_tx_drop)));
 	cnsl->put_string_lf(format("tx failed : %6" PRIu64, uint64_t(total_n_tx_fail)));
@@ -453,9 +540,15 @@ void deqna::write_word(const uint16_t addr, const uint16_t v)
 			new_csr |= 0x8000;
 
 		registers[reg_nr] = new_csr;
+
+		rx_enabled = new_csr & 1;
 	}
 	else if (addr == DEQNA_RX_BDLH) {
+		rx_desc = ((registers[3] & 63) << 16) | registers[2];
 		registers[7] &= ~32;  // RX buffers set, no more invalid
+
+		if (received.is_empty() == false)  // there were no buffers for these
+			schedule_rx_dma();
 	}
 	else if (addr == DEQNA_TX_BDLH) {
 		registers[7] &= ~16;  // TX buffers set, no more invalid
@@ -510,16 +603,17 @@ FLASHMEM bool deqna::test(console *const cnsl)
 			uint64_t time_left = until - get_us();
 			if (time_left < 1000 || time_left > duration)
 				break;
-			auto data = eth_dev->get(time_left / 1000);
-			if (data.first) {
+			eth_frame *frames[eth_rx_batch_size] { };
+			size_t n = eth_dev->get(frames, eth_rx_batch_size, time_left / 1000);
+			for(size_t i=0; i<n; i++) {
 				cnsl->put_char('.');
-				if (data.second >= 14) {
-					for_me += memcmp(data.first, mac_address, 6) == 0;
-					bc     += memcmp(data.first, bc_addr,     6) == 0;
+				if (frames[i]->n >= 14) {
+					for_me += memcmp(frames[i]->data, mac_address, 6) == 0;
+					bc     += memcmp(frames[i]->data, bc_addr,     6) == 0;
 					pkt_total++;
 				}
-				delete [] data.first;
 			}
+			eth_dev->release(frames, n);
 		}
 		cnsl->put_string_lf("");
 
@@ -23,7 +23,7 @@
 #define DEQNA_CSR     0174456
 #define DEQNA_END    (DEQNA_CSR + 2)
 #define DEQNA_IRQ_LEVEL    4
-#define DEQNA_MAX_N_QUEUED 1
+#define DEQNA_MAX_N_QUEUED (eth_n_frames / 2)  // the rest of the pool is for the batches in flight
 
 FLASHMEM class deqna : public device
 {
@@ -33,7 +33,7 @@ public:
 private:
 	bus             *const b        { nullptr };
 	eth_transport   *const eth_dev  { nullptr };
-	std::atomic_uint16_t registers[8] { 0     };  // accessed from multiple threads
+	uint16_t         registers[8]   { 0       };  // only accessed by the cpu thread
 	uint8_t          mac_address[6] { 0       };
 	int              dev_fd         { -1      };
 	abool            stop_flag      { false   };
@@ -41,21 +41,34 @@ private:
 	console         *cnsl           { nullptr };
 	abool           *activity_flag  { nullptr };
 #if defined(FREERTOS)
-	abool rx_low_stopped            { false   };
-	abool rx_high_stopped           { false   };
+	abool rx_stopped                { false   };
 #else
-	std::thread     *th_rx_low      { nullptr };
-	std::thread     *th_rx_high     { nullptr };
+	std::thread     *th_rx          { nullptr };
 #endif
 	mutable my_lock  lock;
-	my_threadsafe_queue<std::pair<uint8_t *, size_t> > received;
+	my_threadsafe_queue<eth_frame *> received;  // frames are from the pool of eth_dev
+	my_threadsafe_queue<int> rx_room;  // rx_dma() took frames from 'received'
+	abool            rx_room_pending  { false };
+	abool            rx_enabled       { false };  // copy of the RE bit for the receiver thread
+	abool            rx_event_pending { false };
+	big_acounter     rx_event         { 0     };  // event_scheduler id of the rx_dma() event
+	uint32_t         rx_desc          { 0     };  // next receive descriptor
 	big_acounter total_n_rx_pkts { 0 };
 	big_acounter total_n_rx_drop { 0 };
+	big_acounter total_n_rx_irqs { 0 };
+	big_acounter total_n_rx_stall{ 0 };  // times the receive queue was full
+	big_acounter rx_queue_max    { 0 };
 	big_acounter total_n_tx_pkts { 0 };
 	big_acounter total_n_tx_drop { 0 };
 	big_acounter total_n_tx_fail { 0 };
 
 	void queue_rx_packet(const uint8_t *const in, const size_t n);
+	size_t get_rx_queue_room() const;
+	void queue_rx_frames(eth_frame *const *const frames, const size_t n);
+	void schedule_rx_dma();
+	void rx_dma         ();
+	bool find_rx_descriptor();
+	void put_rx_frame   (const eth_frame *const frame);
 	void transmitter    ();
 	void purge_buffers  ();
 
@@ -65,9 +78,8 @@ public:
 
 	bool begin();
 
-	// need to be public for the thread wrappers
-	void receiver_low   ();
-	void receiver_high  ();
+	// needs to be public for the thread wrapper
+	void receiver       ();
 
 	void reset(const bool hard) override;
 
@@ -16,6 +16,7 @@
 #include "bus.h"
 #include "cpu.h"
 #include "dz11.h"
+#include "event_scheduler.h"
 #include "log.h"
 #include "utils.h"
 
@@ -33,7 +34,8 @@ static void thread_wrapper_dz11(void *p)
 
 dz11::dz11(bus *const b, comm_io *const io_channels):
 	b(b),
-	io_channels(io_channels)
+	io_channels(io_channels),
+	tx_flush(b, comm_tx_flush_us, [this] { this->io_channels->flush_all(); })
 {
 	connected     .resize(dz11_n_lines);
 	parity_setting.resize(dz11_n_lines);
@@ -46,7 +48,12 @@ dz11::~dz11()
 {
 	DOLOG(log_ss::LS_COMM, "DZ11 closing");
 
+	io_channels->set_notifier(nullptr);
+
+	tx_flush.cancel();
+
 	stop_flag = true;
+	wake_up();
 
 	if (th) {
 		th->join();
@@ -73,6 +80,7 @@ FLASHMEM void dz11::show_state(console *const cnsl) const
 	}
 
 	cnsl->put_string_lf(format(" RX interrupt enabled: %s", is_rx_interrupt_enabled() ? "true": "false" ));
+	cnsl->put_string_lf(format(" silo alarm enabled: %s", registers[0] & 0x1000 ? "true": "false" ));
 	cnsl->put_string_lf(format(" TX interrupt enabled: %s", is_tx_interrupt_enabled() ? "true": "false" ));
 
 	for(int i=0; i<4; i++)
@@ -81,6 +89,8 @@ FLASHMEM void dz11::show_state(console *const cnsl) const
 
 bool dz11::begin()
 {
+	io_channels->set_notifier([this] { wake_up(); });
+
 #if defined(ESP32) || defined(FREERTOS)
 	xTaskCreate(&thread_wrapper_dz11, "dz11", 2048, this, 1, nullptr);
 #else
@@ -111,6 +121,24 @@ void dz11::trigger_interrupt(const bool is_tx)
 	b->getCpu()->queue_interrupt(DZ11_INTERRUPT_LEVEL, is_tx ? DZ11_INTERRUPT_VECTOR_TX : DZ11_INTERRUPT_VECTOR_RX);
 }
 
+// invoked by the comm backends, from their own thread
+void dz11::wake_up()
+{
+	if (rx_wakeup_pending.exchange(true) == false)
+		rx_wakeup.push(0);
+}
+
+void dz11::transmit(const int line_nr, const uint8_t ch)
+{
+	io_channels->queue_data(line_nr, ch);
+	tx_flush.written();
+}
+
+void dz11::flush_tx()
+{
+	tx_flush.flush_now();
+}
+
 #ifdef UNIT_TEST
 void dz11::wait_connected(const int line_nr) const
 {
@@ -142,11 +170,15 @@ void dz11::operator()()
 	DOLOG(log_ss::LS_COMM, "DZ11 thread started");
 
 	while(!stop_flag) {
-		myusleep(10000);
+		// backends that notify when something happened need not be polled
+		rx_wakeup.pop(io_channels->can_notify() ? dz11_idle_poll_ms : dz11_poll_ms);
+		rx_wakeup_pending = false;
 
-		for(int line_nr=0; line_nr<dz11_n_lines; line_nr++) {
-			my_unique_lock lck(&input_lock);
+		my_unique_lock lck(&input_lock);
+
+		int n_received = 0;
 
+		for(int line_nr=0; line_nr<dz11_n_lines; line_nr++) {
 			// (dis-)connected?
 			bool is_connected  = io_channels->is_connected(line_nr);
 			bool was_connected = connected[line_nr] != NOT_CONNECTED;
@@ -176,24 +208,44 @@ void dz11::operator()()
 			}
 
 			// receive data
-			bool have_data = false;
-			while(io_channels->has_data(line_nr)) {
-				uint8_t buffer = io_channels->get_byte(line_nr);
-				recv_buffers[line_nr].push_back(char(buffer));
-				have_data = true;
+			for(;;) {
+				uint8_t buffer[512];
+				size_t  n = io_channels->get_bytes(line_nr, buffer, sizeof buffer);
+				if (n == 0)
+					break;
+				recv_buffers[line_nr].insert(recv_buffers[line_nr].end(), buffer, buffer + n);
+				n_received += n;
 			}
+		}
 
-			if (have_data) {
-				// registers[2]: LINE ENAB
-				if (is_rx_interrupt_enabled()) {
-					DOLOG(log_ss::LS_COMM, "DZ11: have data, trigger interrupt");
-					trigger_interrupt(false);
-				}
-				else {
-					DOLOG(log_ss::LS_COMM, "DZ11: have data, interrupt disabled! (%06o)", registers[0]);
-				}
+		if (n_received == 0)
+			continue;
+
+		silo_alarm_count += n_received;
+
+		// one interrupt for everything that came in (e.g. a paste). with SAE
+		// set, only interrupt when the silo alarm goes off: the driver then
+		// picks up the rest from its clock interrupt.
+		bool alarm = false;
+		if (registers[0] & 0x1000) {  // SAE
+			if (silo_alarm_count >= dz11_silo_alarm && (registers[0] & 0x2000) == 0) {
+				registers[0] |= 0x2000;  // SA
+				alarm = true;
 			}
 		}
+		else {
+			alarm = true;
+		}
+
+		// registers[2]: LINE ENAB
+		if (alarm && is_rx_interrupt_enabled()) {
+			DOLOG(log_ss::LS_COMM, "DZ11: have %d character(s), trigger interrupt", n_received);
+			trigger_interrupt(false);
+		}
+		else {
+			DOLOG(log_ss::LS_COMM, "DZ11: have %d character(s), no interrupt (%06o)", n_received, registers[0]);
+			b->getCpu()->wake_up();
+		}
 	}
 
 	DOLOG(log_ss::LS_COMM, "DZ11 thread terminating");
@@ -255,10 +307,17 @@ uint16_t dz11::read_word(const uint16_t addr)
 	}
 	else if (addr == DZ11_RBUF) {
 		vtemp = 0;
+
+		flush_tx();  // e.g. a prompt before waiting for what the user types
+
+		// reading RBUF clears the silo alarm
+		registers[0] &= ~0x2000;
+		silo_alarm_count = 0;
+
 		for(int i=0; i<dz11_n_lines; i++) {
 			if (recv_buffers[i].empty() == false) {
 				uint8_t c = recv_buffers[i].front();
-				recv_buffers[i].erase(recv_buffers[i].begin());
+				recv_buffers[i].pop_front();
 				bool    p = false;
 				if (parity_setting[i] == EVEN_PARITY)
 					p = !parity(c);
@@ -363,7 +422,7 @@ void dz11::write_word(const uint16_t addr, const uint16_t v)
 		int line_nr = (registers[0] >> 8) & 7;
 		if (line_nr < dz11_n_lines) {
 			char c = parity_setting[line_nr] != NO_PARITY ? v & 127 : v;  // mask off parity
-			io_channels->send_data(line_nr, reinterpret_cast<const uint8_t *>(&c), 1);
+			transmit(line_nr, c);
 			DOLOG(log_ss::LS_COMM, "DZ11 TRANSMIT %c (%d) on line %d", c, v, line_nr);
 		}
 
@@ -519,6 +578,7 @@ TEST(dz11, dz11tests) {
 	d.write_word(0160104, 3);  // enable line 0 & 1
 	int line = (d.read_word(0160100) >> 8) & 7;
 	d.write_word(0160106, 0x44);  // TBUF
+	d.read_word(0160102);  // reading RBUF sends the buffered output
 	std::vector<uint8_t> data_tx[] { tty1->get_tx_data(), tty2->get_tx_data() };
 	EXPECT_EQ(data_tx[line].size(), 1);  // has data
 	EXPECT_EQ(data_tx[1 - line].size(), 0);  // has no data
@@ -4,6 +4,7 @@
 #pragma once
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <thread>
 #include <vector>
 
@@ -13,6 +14,7 @@
 #include "bus.h"
 #include "log.h"
 #include "my_lock.h"
+#include "tx_flush_timer.h"
 
 class bus;
 
@@ -23,6 +25,9 @@ constexpr const int dz11_n_lines = 8;
 constexpr const int dz11_n_lines = 4;
 #endif
 constexpr const int n_dz11_registers = 6;
+constexpr const int dz11_poll_ms      = 10;    // when one or more backends cannot notify
+constexpr const int dz11_idle_poll_ms = 1000;  // only as a fall-back
+constexpr const int dz11_silo_alarm   = 16;    // characters until the silo alarm interrupt
 
 #define DZ11_INTERRUPT_VECTOR_RX 0310
 #define DZ11_INTERRUPT_VECTOR_TX 0314
@@ -52,14 +57,23 @@ private:
 	enum psetting { NO_PARITY = 0, ODD_PARITY, EVEN_PARITY };
 	std::vector<psetting> parity_setting;
 
-	std::vector<char>     recv_buffers[dz11_n_lines];
+	std::deque<char>      recv_buffers[dz11_n_lines];
+	int                   silo_alarm_count { 0 };  // characters received since the last RBUF read
         mutable my_lock       input_lock;
 
+	my_threadsafe_queue<int> rx_wakeup;  // the comm backends have news
+	abool                 rx_wakeup_pending { false };
+
+	tx_flush_timer        tx_flush;  // sends what queue_data() buffered
+
 	void trigger_interrupt(const bool is_tx);
+	void wake_up();
 	bool is_rx_interrupt_enabled() const;
 	bool is_tx_interrupt_enabled() const;
 	void tx_scanner_do(const int line, const bool force = false);
 	void tx_scanner(const std::optional<int> line, const bool force = false);
+	void transmit(const int line_nr, const uint8_t ch);
+	void flush_tx();
 
 public:
 	dz11(bus *const b, comm_io *const io_channels);
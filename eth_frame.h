@@ -0,0 +1,77 @@
+// (C) 2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "my_lock.h"
+
+
+constexpr const size_t eth_max_frame_size = 1536;  // 1514 + room for e.g. the vxlan header
+#if IS_POSIX
+constexpr const size_t eth_n_frames       = 64;
+constexpr const size_t eth_rx_batch_size  = 16;
+#else
+constexpr const size_t eth_n_frames       = 4;
+constexpr const size_t eth_rx_batch_size  = 1;
+#endif
+
+struct eth_frame
+{
+	size_t  n { 0 };
+	uint8_t data[eth_max_frame_size];
+};
+
+// a fixed set of frame buffers, so that receiving does not allocate memory.
+// frames are taken and given back in batches: one lock for a batch.
+class eth_frame_pool
+{
+private:
+	mutable my_lock          lock;
+	std::vector<eth_frame>   frames;
+	std::vector<eth_frame *> free_frames;
+
+public:
+	eth_frame_pool(const size_t n) : frames(n) {
+		for(auto & f: frames)
+			free_frames.push_back(&f);
+	}
+
+	~eth_frame_pool() {
+	}
+
+	// returns how many were put in 'out', 0 when all are in use
+	size_t get(eth_frame **const out, const size_t n) {
+		my_unique_lock lck(&lock);
+		size_t count = 0;
+		while(count < n && free_frames.empty() == false) {
+			out[count++] = free_frames.back();
+			free_frames.pop_back();
+		}
+		return count;
+	}
+
+	eth_frame *get() {
+		eth_frame *f = nullptr;
+		get(&f, 1);
+		return f;
+	}
+
+	void put(eth_frame *const *const in, const size_t n) {
+		my_unique_lock lck(&lock);
+		free_frames.insert(free_frames.end(), in, in + n);
+	}
+
+	void put(eth_frame *const f) {
+		put(&f, 1);
+	}
+
+	size_t get_n_free() const {
+		my_unique_lock lck(&lock);
+		return free_frames.size();
+	}
+};
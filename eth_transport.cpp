@@ -16,4 +16,5 @@ FLASHMEM void eth_transport::show_state(console *const cnsl) const
 {
 	cnsl->put_string_lf(format("%s packets received   : %" PRIu64, identifier().c_str(), pkt_cnt_rx));
 	cnsl->put_string_lf(format("%s packets transmitted: %" PRIu64, identifier().c_str(), pkt_cnt_tx));
+	cnsl->put_string_lf(format("%s free frame buffers : %" PRIzu, identifier().c_str(), pool.get_n_free()));
 }
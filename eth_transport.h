@@ -4,7 +4,8 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
-#include <utility>
+
+#include "eth_frame.h"
 
 class console;
 
@@ -14,6 +15,7 @@ protected:
 	uint64_t    pkt_cnt_rx     { 0     };
 	uint64_t    pkt_cnt_tx     { 0     };
 	bool        trace          { false };
+	eth_frame_pool pool        { eth_n_frames };
 
 public:
 	eth_transport();
@@ -27,5 +29,11 @@ public:
 	virtual void show_state(console *const cnsl) const;
 
 	virtual bool transmit(const uint8_t *const data, const size_t n_bytes) = 0;
-	virtual std::pair<uint8_t *, size_t> get(const int timeout) = 0;
+	// waits at most 'timeout' ms for a frame, then returns what is there (at
+	// most 'n_max'). the frames come from the pool: give them back via release()
+	virtual size_t get(eth_frame **const out, const size_t n_max, const int timeout) = 0;
+
+	eth_frame_pool *get_pool() { return &pool; }
+	void release(eth_frame *const *const frames, const size_t n) { pool.put(frames, n); }
+	void release(eth_frame *const f) { pool.put(f); }
 };
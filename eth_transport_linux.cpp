@@ -109,6 +109,9 @@ bool eth_transport_linux::begin()
 	const std::string script = "./kek-if-up.sh";
 	fd = open_tun(dev_name);
 	if (fd != -1) {
+		// get() reads until nothing is left
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
 		if (file_exists(script)) {
 			int rc = fork();
 			if (rc == 0) {
@@ -141,27 +144,39 @@ bool eth_transport_linux::transmit(const uint8_t *const data, const size_t n_byt
 	return rc == ssize_t(n_bytes);
 }
 
-std::pair<uint8_t *, size_t> eth_transport_linux::get(const int timeout)
+// one frame per read() on a tap device: read all that is there in one go
+size_t eth_transport_linux::get(eth_frame **const out, const size_t n_max, const int timeout)
 {
 	pollfd fds[] { { fd, POLLIN, 0 } };
 	int    rc = poll(fds, 1, timeout);
 	if (rc <= 0)
-		return { nullptr, 0 };
-
-	pkt_cnt_rx++;
-	constexpr const int max_pkt_size = 1512;
-	uint8_t *pkt = new uint8_t[max_pkt_size]();
-	int      rc2 = read(fd, pkt, max_pkt_size);
-	if (rc2 == -1) {
-		delete [] pkt;
-		pkt = nullptr;
-		rc2 = 0;
+		return 0;
+
+	size_t n = pool.get(out, n_max);
+	if (n == 0) {
+		DOLOG(log_ss::LS_ETH, "no free frame buffers");
+		return 0;
+	}
+
+	size_t count = 0;
+	while(count < n) {
+		eth_frame *f   = out[count];
+		ssize_t    rc2 = read(fd, f->data, sizeof f->data);
+		if (rc2 <= 0)
+			break;
+
+		f->n = rc2;
+		count++;
+
+		if (trace)
+			printf("Pkt to %02x:%02x:%02x:%02x:%02x:%02x processed\n",
+					f->data[0], f->data[1], f->data[2], f->data[3], f->data[4], f->data[5]);
 	}
 
-	if (trace)
-		printf("Pkt to %02x:%02x:%02x:%02x:%02x:%02x processed\n",
-				pkt[0], pkt[1], pkt[2], pkt[3], pkt[4], pkt[5]);
+	pool.put(&out[count], n - count);  // not used
+
+	pkt_cnt_rx += count;
 
-	return { pkt, rc2 };
+	return count;
 }
 #endif
@@ -1,4 +1,6 @@
 #include "gen.h"
+#include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
 #if defined(BUILD_FOR_PICO2W)
@@ -27,7 +29,7 @@
 
 // https://www.rfc-editor.org/rfc/rfc7348
 
-constexpr const int max_pkt_size = 1512;
+constexpr const size_t vxlan_header_size = 8;
 
 eth_transport_vxlan::eth_transport_vxlan(const std::string & peer, const int port, const uint32_t id):
 	peer(peer),
@@ -75,14 +77,19 @@ std::string eth_transport_vxlan::identifier() const
 
 bool eth_transport_vxlan::transmit(const uint8_t *const data, const size_t n_bytes)
 {
+	if (n_bytes + vxlan_header_size > eth_max_frame_size) {
+		DOLOG(log_ss::LS_ETH, "frame too large (%" PRIzu " bytes)", n_bytes);
+		return false;
+	}
+
 	bool     rc        = true;
-	size_t   wrapped_n = n_bytes + 8;
-	uint8_t *wrapped   = new uint8_t[wrapped_n]();
+	size_t   wrapped_n = n_bytes + vxlan_header_size;
+	uint8_t  wrapped[eth_max_frame_size] { };
 	wrapped[0] = 0x08;
 	wrapped[4] = id >> 16;
 	wrapped[5] = id >> 8;
 	wrapped[6] = id;
-	memcpy(&wrapped[8], data, n_bytes);
+	memcpy(&wrapped[vxlan_header_size], data, n_bytes);
 
 #if defined(BUILD_FOR_PICO2W) || defined(TEENSY4_1)
 	udp.begin(port);
@@ -100,14 +107,12 @@ bool eth_transport_vxlan::transmit(const uint8_t *const data, const size_t n_byt
 	serveraddr.sin_addr.s_addr = inet_addr(peer.c_str());
 #else
 	if (inet_pton(AF_INET, peer.c_str(), &serveraddr.sin_addr) == 0) {
-		delete [] wrapped;
 		DOLOG(log_ss::LS_ETH, "inet_pton(%s) failed", peer.c_str());
 		return false;
 	}
 #endif
 #else
 	if (inet_aton(peer.c_str(), &serveraddr.sin_addr) == 0) {
-		delete [] wrapped;
 		DOLOG(log_ss::LS_ETH, "inet_aton(%s) failed", peer.c_str());
 		return false;
 	}
@@ -119,34 +124,54 @@ bool eth_transport_vxlan::transmit(const uint8_t *const data, const size_t n_byt
 	}
 #endif
 
-	delete [] wrapped;
 	pkt_cnt_tx++;
 
 	return rc;
 }
 
-std::pair<uint8_t *, size_t> eth_transport_vxlan::get(const int timeout)
+// strips the vxlan header, false if the frame is not for us
+bool eth_transport_vxlan::unwrap(eth_frame *const f)
+{
+	if (f->n < 14 + vxlan_header_size)
+		return false;
+
+	uint32_t their_id = (f->data[4] << 16) | (f->data[5] << 8) | f->data[6];
+	if (f->data[0] != 0x08 || their_id != id) {
+		DOLOG(log_ss::LS_ETH, "vxlan id mismatch: %02x != %02x", their_id, id);
+		return false;
+	}
+
+	f->n -= vxlan_header_size;
+	memmove(&f->data[0], &f->data[vxlan_header_size], f->n);
+
+#if !IS_POSIX && !defined(_WIN32)
+	if (trace)
+		Serial.println(format("Pkt to %02x:%02x:%02x:%02x:%02x:%02x processed",
+					f->data[0], f->data[1], f->data[2], f->data[3], f->data[4], f->data[5]).c_str());
+#endif
+
+	return true;
+}
+
+size_t eth_transport_vxlan::get(eth_frame **const out, const size_t n_max, const int timeout)
 {
-	uint8_t *pkt         = nullptr;
-	size_t   packet_size = 0;
+	size_t n_received = 0;
 #if defined(BUILD_FOR_PICO2W) || defined(TEENSY4_1)
 	auto start = millis();
 	while(millis() - start < timeout) {
 		int rc = udp.parsePacket();
 		if (rc > 0) {
-			pkt = new uint8_t[rc];
-			if (!pkt) {
-				DOLOG(log_ss::LS_ETH, "malloc issue");
-				return { nullptr, 0 };
+			eth_frame *f = pool.get();
+			if (!f) {
+				DOLOG(log_ss::LS_ETH, "no free frame buffers");
+				return 0;
 			}
-			udp.read(pkt, rc);
-			packet_size = rc;
+			f->n = udp.read(f->data, std::min(size_t(rc), sizeof f->data));
+			out[0] = f;
+			n_received = 1;
 			break;
 		}
 	}
-
-	if (!pkt)
-		return { nullptr, 0 };
 #else
 #if defined(_WIN32)
 	WSAPOLLFD fds[] { { fd, POLLIN, 0 } };
@@ -156,37 +181,51 @@ std::pair<uint8_t *, size_t> eth_transport_vxlan::get(const int timeout)
 	int rc = poll(fds, 1, timeout);
 #endif
 	if (rc <= 0)
-		return { nullptr, 0 };
+		return 0;
 
-	pkt = new uint8_t[max_pkt_size]();
-	int      rc2 = recv(fd, reinterpret_cast<char *>(pkt), max_pkt_size, 0);
-	if (rc2 == -1) {
-		delete [] pkt;
-		return { nullptr, 0 };
-	}
-	packet_size = rc2;
-#endif
-	pkt_cnt_rx++;
-	if (packet_size < 14 + 8) {
-		delete [] pkt;
-		return { nullptr, 0 };
+	size_t n = pool.get(out, n_max);
+	if (n == 0) {
+		DOLOG(log_ss::LS_ETH, "no free frame buffers");
+		return 0;
 	}
 
-	uint32_t their_id = (pkt[4] << 16) | (pkt[5] << 8) | pkt[6];
-	if (pkt[0] != 0x08 || their_id != id) {
-		DOLOG(log_ss::LS_ETH, "vxlan id mismatch: %02x != %02x", their_id, id);
-		delete [] pkt;
-		return { nullptr, 0 };
+#if defined(__linux__)
+	// all datagrams that are there with one system call
+	mmsghdr msgs[eth_rx_batch_size] { };
+	iovec   iovs[eth_rx_batch_size] { };
+	n = std::min(n, eth_rx_batch_size);
+	for(size_t i=0; i<n; i++) {
+		iovs[i].iov_base           = out[i]->data;
+		iovs[i].iov_len            = sizeof out[i]->data;
+		msgs[i].msg_hdr.msg_iov    = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
 	}
 
-	packet_size -= 8;
-	memmove(&pkt[0], &pkt[8], packet_size);
-
-#if !IS_POSIX && !defined(_WIN32)
-	if (trace)
-		Serial.println(format("Pkt to %02x:%02x:%02x:%02x:%02x:%02x processed",
-					pkt[0], pkt[1], pkt[2], pkt[3], pkt[4], pkt[5]).c_str());
+	int rc2 = recvmmsg(fd, msgs, n, MSG_DONTWAIT, nullptr);
+	if (rc2 > 0) {
+		n_received = rc2;
+		for(size_t i=0; i<n_received; i++)
+			out[i]->n = msgs[i].msg_len;
+	}
+#else
+	int rc2 = recv(fd, reinterpret_cast<char *>(out[0]->data), sizeof out[0]->data, 0);
+	if (rc2 > 0) {
+		out[0]->n  = rc2;
+		n_received = 1;
+	}
 #endif
+	pool.put(&out[n_received], n - n_received);  // not used
+#endif
+	pkt_cnt_rx += n_received;
+
+	// drop what is not for us
+	size_t n_out = 0;
+	for(size_t i=0; i<n_received; i++) {
+		if (unwrap(out[i]))
+			out[n_out++] = out[i];
+		else
+			pool.put(out[i]);
+	}
 
-	return { pkt, packet_size };
+	return n_out;
 }
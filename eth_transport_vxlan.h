@@ -22,6 +22,8 @@ private:
 	int               fd   { -1   };
 #endif
 
+	bool unwrap(eth_frame *const f);
+
 public:
 	eth_transport_vxlan(const std::string & peer, const int port = 4789, const uint32_t id = 0);
 	virtual ~eth_transport_vxlan();
@@ -31,5 +33,5 @@ public:
 	std::string identifier() const override;
 
 	bool transmit(const uint8_t *const data, const size_t n_bytes) override;
-	std::pair<uint8_t *, size_t> get(const int timeout) override;
+	size_t get(eth_frame **const out, const size_t n_max, const int timeout) override;
 };
@@ -0,0 +1,127 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#include <algorithm>
+
+#include "event_scheduler.h"
+
+
+event_scheduler::event_scheduler()
+{
+}
+
+event_scheduler::~event_scheduler()
+{
+}
+
+// invoked with 'lock' held
+void event_scheduler::update_next_due()
+{
+	next_due = events.empty() ? UINT64_MAX : events.front().due;
+}
+
+uint64_t event_scheduler::schedule(const uint64_t due, const callback_t & cb)
+{
+	my_unique_lock lck(&lock);
+
+	uint64_t id = next_id++;
+
+	events.push_back({ due, id, cb });
+	std::push_heap(events.begin(), events.end(), later);
+
+	update_next_due();
+
+	return id;
+}
+
+bool event_scheduler::cancel(const uint64_t id)
+{
+	my_unique_lock lck(&lock);
+
+	auto it = std::find_if(events.begin(), events.end(), [id](const event & e) { return e.id == id; });
+	if (it == events.end())
+		return false;
+
+	events.erase(it);
+	std::make_heap(events.begin(), events.end(), later);
+
+	update_next_due();
+
+	return true;
+}
+
+void event_scheduler::clear()
+{
+	my_unique_lock lck(&lock);
+
+	events.clear();
+
+	update_next_due();
+}
+
+size_t event_scheduler::get_n_pending()
+{
+	my_unique_lock lck(&lock);
+
+	return events.size();
+}
+
+bool event_scheduler::pop_if(const uint64_t now, const bool any, event *const out)
+{
+	my_unique_lock lck(&lock);
+
+	if (events.empty() || (any == false && events.front().due > now))
+		return false;
+
+	std::pop_heap(events.begin(), events.end(), later);
+	*out = std::move(events.back());
+	events.pop_back();
+
+	update_next_due();
+
+	return true;
+}
+
+void event_scheduler::run_due(const uint64_t now)
+{
+	event e;
+
+	// the lock is not held while a callback runs: it may schedule a new event
+	while(pop_if(now, false, &e))
+		e.cb();
+}
+
+void event_scheduler::run_all()
+{
+	if (next_due == UINT64_MAX)
+		return;
+
+	uint64_t id_limit = 0;
+	{
+		my_unique_lock lck(&lock);
+		id_limit = next_id;
+	}
+
+	std::vector<event> new_events;
+	event e;
+
+	while(pop_if(0, true, &e)) {
+		if (e.id >= id_limit)  // e.g. a recurring event: leave it for later
+			new_events.push_back(std::move(e));
+		else
+			e.cb();
+	}
+
+	if (new_events.empty())
+		return;
+
+	my_unique_lock lck(&lock);
+
+	for(auto & ne: new_events) {
+		events.push_back(std::move(ne));
+		std::push_heap(events.begin(), events.end(), later);
+	}
+
+	update_next_due();
+}
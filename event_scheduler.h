@@ -0,0 +1,54 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "my_lock.h"
+
+
+// device events ordered by emulated time. the time base is the number of
+// instructions executed: the cpu invokes run_due() between instructions
+// once the first event is due, so the callbacks run in the cpu thread and
+// can e.g. queue an interrupt without any other thread being involved.
+// schedule() and cancel() can be used from any thread.
+class event_scheduler
+{
+public:
+	typedef std::function<void()> callback_t;
+
+private:
+	struct event {
+		uint64_t   due;
+		uint64_t   id;  // also keeps events that are due at the same moment in order
+		callback_t cb;
+	};
+
+	my_lock            lock;
+	std::vector<event> events;  // min-heap on 'due'
+	uint64_t           next_id  { 1          };
+	big_acounter       next_due { UINT64_MAX };  // copy of the top, read without locking
+
+	static bool later(const event & a, const event & b) { return a.due > b.due || (a.due == b.due && a.id > b.id); }
+	void        update_next_due();
+	bool        pop_if(const uint64_t now, const bool any, event *const out);
+
+public:
+	event_scheduler();
+	~event_scheduler();
+
+	uint64_t schedule(const uint64_t due, const callback_t & cb);  // returns an id for cancel()
+	bool     cancel  (const uint64_t id);
+	void     clear   ();
+
+	uint64_t get_next_due() const { return next_due; }
+	size_t   get_n_pending();
+
+	void     run_due (const uint64_t now);
+	// invoke all events, due or not. not those that they schedule themselves
+	void     run_all ();
+};
@@ -0,0 +1,658 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#include <cmath>
+#include <cstring>
+
+#include "bus.h"
+#include "cpu.h"
+#include "fp11.h"
+#include "log.h"
+#include "utils.h"
+
+
+constexpr const uint64_t FP_SIGN     = 1ull << 63;
+constexpr const uint64_t FP_EXP_MASK = 0377ull << 55;
+
+fp11::fp11(cpu *const c, bus *const b) : c(c), b(b)
+{
+	reset();
+}
+
+fp11::~fp11()
+{
+}
+
+void fp11::reset()
+{
+	memset(ac, 0x00, sizeof ac);
+	fps = 0;
+	fec = 0;
+	fea = 0;
+}
+
+double fp11::to_host(const uint64_t v)
+{
+	int exponent = (v >> 55) & 0377;
+	if (exponent == 0)  // zero, regardless of the fraction
+		return 0.;
+
+	uint64_t mantissa = (v & ~(FP_SIGN | FP_EXP_MASK)) | (1ull << 55);  // add the hidden bit
+	double   out      = std::ldexp(double(mantissa), exponent - 128 - 56);
+
+	return v & FP_SIGN ? -out : out;
+}
+
+std::pair<uint64_t, int> fp11::from_host(const double v, const bool d, const bool chop)
+{
+	if (v == 0.)
+		return { 0, 0 };
+
+	int      exponent = 0;
+	double   m        = std::frexp(std::fabs(v), &exponent);  // 0.5 <= m < 1, like the PDP-11 fraction
+	int      n_bits   = d ? 56 : 24;  // including the hidden bit
+	double   scaled   = std::ldexp(m, n_bits);
+	uint64_t mantissa = uint64_t(chop ? scaled : scaled + 0.5);
+
+	if (mantissa >> n_bits) {  // rounded up to the next power of 2
+		mantissa >>= 1;
+		exponent++;
+	}
+
+	exponent += 128;
+
+	uint64_t out = (v < 0 ? FP_SIGN : 0) | (uint64_t(exponent & 0377) << 55) | ((mantissa & ~(1ull << (n_bits - 1))) << (56 - n_bits));
+
+	return { out, exponent };
+}
+
+// D to F without going through the host double (which has fewer bits than D)
+static std::pair<uint64_t, int> d_to_f(const uint64_t v, const bool chop)
+{
+	if ((v & FP_EXP_MASK) == 0)
+		return { 0, 0 };
+
+	uint64_t magnitude = v & ~FP_SIGN;
+	if (!chop)  // a carry out of the fraction ends up in the exponent
+		magnitude += 1ull << 31;
+
+	return { (v & FP_SIGN) | (magnitude & (B64_MSWSET & ~FP_SIGN)), int(magnitude >> 55) };
+}
+
+// conversion, overflow, underflow and undefined variable errors are ignored
+// when their interrupt is not enabled; the others (illegal opcode, divide by
+// zero) are always reported
+// returns true if the FP trap was taken
+bool fp11::fp_error(const uint16_t code)
+{
+	uint16_t enable = 0;
+
+	if (code == FEC_ICVT)
+		enable = FPS_IC;
+	else if (code == FEC_OVERFLOW)
+		enable = FPS_IV;
+	else if (code == FEC_UNDERFLW)
+		enable = FPS_IU;
+	else if (code == FEC_UNDEF)
+		enable = FPS_IUV;
+
+	if (enable && (fps & enable) == 0)
+		return false;
+
+	DOLOG(log_ss::LS_CPU, "FP11 error %d @ %06o", code, c->get_instruction_start());
+
+	fec  = code;
+	fea  = c->get_instruction_start();
+	fps |= FPS_ER;
+
+	if (fps & FPS_ID)
+		return false;
+
+	c->trap(0244);
+
+	return true;
+}
+
+void fp11::set_fps_nz(const uint64_t v)
+{
+	fps &= ~(FPS_N | FPS_Z | FPS_V | FPS_C);
+
+	if (v & FP_SIGN)
+		fps |= FPS_N;
+	if ((v & FP_EXP_MASK) == 0)
+		fps |= FPS_Z;
+}
+
+void fp11::copy_condition_codes()
+{
+	c->setPSW_n(fps & FPS_N);
+	c->setPSW_z(fps & FPS_Z);
+	c->setPSW_v(fps & FPS_V);
+	c->setPSW_c(fps & FPS_C);
+}
+
+uint64_t fp11::get_ac_value(const int nr, const bool d) const
+{
+	return d ? ac[nr] : ac[nr] & B64_MSWSET;
+}
+
+void fp11::set_ac(const int nr, const uint64_t v, const bool d)
+{
+	ac[nr] = d ? v : v & B64_MSWSET;
+}
+
+// r is a value + the exponent it should have gotten (see from_host()); on
+// over- or underflow the result is 0 unless the interrupt for it is enabled,
+// then the exponent wraps around
+uint64_t fp11::check_range(const std::pair<uint64_t, int> & r, const bool is_zero, uint16_t *const error)
+{
+	auto [ v, exponent ] = r;
+
+	*error = 0;
+
+	if (exponent > 0377) {
+		*error = FEC_OVERFLOW;
+		if ((fps & FPS_IV) == 0)
+			v = 0;
+	}
+	else if (exponent < 1 && is_zero == false) {
+		*error = FEC_UNDERFLW;
+		if ((fps & FPS_IU) == 0)
+			v = 0;
+	}
+
+	set_fps_nz(v);
+
+	if (*error == FEC_OVERFLOW)
+		fps |= FPS_V;
+
+	return v;
+}
+
+uint64_t fp11::round_result(const double v, const bool d, uint16_t *const error)
+{
+	return check_range(from_host(v, d, fps & FPS_T), v == 0., error);
+}
+
+// effective address of an operand of 'n_bytes'; (Rn)+ and -(Rn) step by the
+// size of the operand, except for the PC: immediate is always 1 word
+fp11::fp_operand fp11::get_operand(const int mode, const int reg, const int n_bytes)
+{
+	fp_operand o { mode == 0, reg, 0, d_space, n_bytes / 2 };
+
+	if (mode == 0) {
+		if (reg >= 6) {  // there's no AC6 and AC7
+			fp_error(FEC_OPCODE);
+			throw 14;
+		}
+
+		return o;
+	}
+
+	d_i_space_t isR7_space = reg == 7 ? i_space : d_space;
+	int         run_mode   = c->getPSW_runmode();
+	int         delta      = reg == 7 ? 2 : n_bytes;
+
+	switch(mode) {
+		case 1:  // (Rn)
+			o.addr  = c->get_register(reg);
+			o.space = isR7_space;
+			break;
+
+		case 2:  // (Rn)+  /  #n
+			o.addr  = c->get_register(reg);
+			o.space = isR7_space;
+			if (reg == 7)
+				o.n_words = 1;
+			c->add_register(reg, delta);
+			c->add_to_MMR1(reg, delta);
+			break;
+
+		case 3:  // @(Rn)+  /  @#a
+			o.addr = b->read(c->get_register(reg), wm_word, run_mode, isR7_space);
+			c->add_to_MMR1(reg, 2);
+			c->add_register(reg, 2);
+			break;
+
+		case 4:  // -(Rn)
+			o.addr  = c->add_register(reg, -delta);
+			o.space = isR7_space;
+			c->add_to_MMR1(reg, -delta);
+			break;
+
+		case 5:  // @-(Rn)
+			o.addr = b->read(c->add_register(reg, -2), wm_word, run_mode, isR7_space);
+			c->add_to_MMR1(reg, -2);
+			break;
+
+		case 6: {  // x(Rn)  /  a
+			uint16_t next_word = c->fetch_word(c->getPC());
+			c->add_register(7, 2);
+			o.addr = c->get_register(reg) + next_word;
+			break;
+		}
+
+		case 7: {  // @x(Rn)  /  @a
+			uint16_t next_word = c->fetch_word(c->getPC());
+			c->add_register(7, 2);
+			o.addr = b->read(c->get_register(reg) + next_word, wm_word, run_mode, d_space);
+			break;
+		}
+	}
+
+	return o;
+}
+
+uint64_t fp11::read_operand(const fp_operand & o, const bool d)
+{
+	if (o.is_ac)
+		return get_ac_value(o.reg, d);
+
+	int      run_mode = c->getPSW_runmode();
+	uint64_t v        = 0;
+
+	// most significant word first; what is not read (immediate) is 0
+	for(int i=0; i<4; i++) {
+		v <<= 16;
+		if (i < o.n_words)
+			v |= b->read(o.addr + i * 2, wm_word, run_mode, o.space);
+	}
+
+	return v;
+}
+
+void fp11::write_operand(const fp_operand & o, const uint64_t v, const bool d)
+{
+	if (o.is_ac) {
+		set_ac(o.reg, v, d);
+		return;
+	}
+
+	int run_mode = c->getPSW_runmode();
+
+	for(int i=0; i<o.n_words; i++)
+		b->write(o.addr + i * 2, wm_word, uint16_t(v >> (48 - i * 16)), run_mode, o.space);
+}
+
+// -0 ("undefined variable") traps if enabled, other values with a 0 exponent are 0
+uint64_t fp11::read_fsrc(const int mode, const int reg, const bool d)
+{
+	uint64_t v = read_operand(get_operand(mode, reg, d ? 8 : 4), d);
+
+	if ((v & FP_EXP_MASK) == 0) {
+		if ((v & FP_SIGN) && fp_error(FEC_UNDEF))
+			throw 14;
+
+		return 0;
+	}
+
+	return v;
+}
+
+// in mode 0 a general register is used; for long integers that is the high word
+int32_t fp11::read_integer(const int mode, const int reg, const bool l)
+{
+	if (mode == 0) {
+		uint16_t v = c->get_register(reg);
+		return l ? int32_t(uint32_t(v) << 16) : int16_t(v);
+	}
+
+	fp_operand o        = get_operand(mode, reg, l ? 4 : 2);
+	int        run_mode = c->getPSW_runmode();
+	uint32_t   v        = 0;
+
+	for(int i=0; i<2; i++) {
+		v <<= 16;
+		if (i < o.n_words)
+			v |= b->read(o.addr + i * 2, wm_word, run_mode, o.space);
+	}
+
+	return l ? int32_t(v) : int16_t(v >> 16);
+}
+
+void fp11::write_integer(const int mode, const int reg, const int32_t v, const bool l)
+{
+	if (mode == 0) {
+		c->set_register(reg, l ? v >> 16 : v);
+		return;
+	}
+
+	fp_operand o        = get_operand(mode, reg, l ? 4 : 2);
+	int        run_mode = c->getPSW_runmode();
+	uint32_t   work     = l ? v : uint32_t(v) << 16;
+
+	for(int i=0; i<o.n_words; i++)
+		b->write(o.addr + i * 2, wm_word, uint16_t(work >> (16 - i * 16)), run_mode, o.space);
+}
+
+bool fp11::execute(const uint16_t instr)
+{
+	if ((instr & 0170000) != 0170000)
+		return false;
+
+	int group = (instr >> 8) & 15;
+
+	if (group == 0)
+		misc_instructions(instr);
+	else if (group == 1)
+		single_operand_instructions(instr);
+	else
+		accumulator_instructions(instr);
+
+	return true;
+}
+
+void fp11::misc_instructions(const uint16_t instr)
+{
+	int mode = (instr >> 3) & 7;
+	int reg  = instr & 7;
+
+	switch((instr >> 6) & 3) {
+		case 0:
+			switch(instr & 077) {
+				case 000:  // CFCC
+					copy_condition_codes();
+					break;
+				case 001:  // SETF
+					fps &= ~FPS_D;
+					break;
+				case 011:  // SETD
+					fps |= FPS_D;
+					break;
+				case 002:  // SETI
+					fps &= ~FPS_L;
+					break;
+				case 012:  // SETL
+					fps |= FPS_L;
+					break;
+				default:
+					fp_error(FEC_OPCODE);
+					break;
+			}
+			break;
+
+		case 1:  // LDFPS
+			fps = read_integer(mode, reg, false) & 0147777;  // 12/13 are not used
+			break;
+
+		case 2:  // STFPS
+			write_integer(mode, reg, fps, false);
+			break;
+
+		case 3:  // STST: FEC, FEA
+			write_integer(mode, reg, (fec << 16) | fea, true);
+			break;
+	}
+}
+
+// CLRF, TSTF, ABSF, NEGF
+void fp11::single_operand_instructions(const uint16_t instr)
+{
+	bool d         = is_double();
+	int  mode      = (instr >> 3) & 7;
+	int  reg       = instr & 7;
+	int  operation = (instr >> 6) & 3;
+
+	if (operation == 1) {  // TSTF
+		set_fps_nz(read_fsrc(mode, reg, d));
+		return;
+	}
+
+	fp_operand o = get_operand(mode, reg, d ? 8 : 4);
+	uint64_t   v = 0;
+
+	if (operation != 0) {
+		v = read_operand(o, d);
+
+		if ((v & FP_EXP_MASK) == 0) {
+			if ((v & FP_SIGN) && fp_error(FEC_UNDEF))
+				throw 14;
+
+			v = 0;
+		}
+		else if (operation == 2) {  // ABSF
+			v &= ~FP_SIGN;
+		}
+		else {  // NEGF
+			v ^= FP_SIGN;
+		}
+	}
+
+	write_operand(o, v, d);
+	set_fps_nz(v);
+}
+
+void fp11::accumulator_instructions(const uint16_t instr)
+{
+	bool     d         = is_double();
+	bool     chop      = fps & FPS_T;
+	int      operation = (instr >> 8) & 15;
+	int      ac_nr     = (instr >> 6) & 3;
+	int      mode      = (instr >> 3) & 7;
+	int      reg       = instr & 7;
+	uint16_t error     = 0;
+
+	switch(operation) {
+		case 002:  // MULF
+		case 004:  // ADDF
+		case 006:  // SUBF
+		case 011: {  // DIVF
+			double src = to_host(read_fsrc(mode, reg, d));
+			double acc = to_host(get_ac_value(ac_nr, d));
+			double r   = 0.;
+
+			if (operation == 011) {
+				if (src == 0.) {  // AC is left as is
+					fp_error(FEC_DIV_ZERO);
+					return;
+				}
+
+				r = acc / src;
+			}
+			else if (operation == 002) {
+				r = acc * src;
+			}
+			else {
+				r = operation == 004 ? acc + src : acc - src;
+			}
+
+			set_ac(ac_nr, round_result(r, d, &error), d);
+			break;
+		}
+
+		case 003: {  // MODF: fraction in AC, integer part in AC+1 (when AC is even)
+			double   r          = to_host(get_ac_value(ac_nr, d)) * to_host(read_fsrc(mode, reg, d));
+			double   int_part   = std::trunc(r);
+			uint16_t error_int  = 0;
+			uint64_t int_value  = round_result(int_part, d, &error_int);
+			uint64_t frac_value = round_result(r - int_part, d, &error);
+
+			if ((ac_nr & 1) == 0)
+				set_ac(ac_nr | 1, int_value, d);
+			set_ac(ac_nr, frac_value, d);
+
+			if (error_int == FEC_OVERFLOW) {
+				fps  |= FPS_V;
+				error = error_int;
+			}
+			break;
+		}
+
+		case 005: {  // LDF
+			uint64_t v = read_fsrc(mode, reg, d);
+			set_ac(ac_nr, v, d);
+			set_fps_nz(v);
+			break;
+		}
+
+		case 007: {  // CMPF
+			double src = to_host(read_fsrc(mode, reg, d));
+			double acc = to_host(get_ac_value(ac_nr, d));
+
+			fps &= ~(FPS_N | FPS_Z | FPS_V | FPS_C);
+			if (src < acc)
+				fps |= FPS_N;
+			else if (src == acc)
+				fps |= FPS_Z;
+			break;
+		}
+
+		case 010:  // STF
+			write_operand(get_operand(mode, reg, d ? 8 : 4), get_ac_value(ac_nr, d), d);
+			break;
+
+		case 012: {  // STEXP
+			int exponent = int((ac[ac_nr] & FP_EXP_MASK) >> 55) - 128;
+
+			fps &= ~(FPS_N | FPS_Z | FPS_V | FPS_C);
+			if (exponent < 0)
+				fps |= FPS_N;
+			else if (exponent == 0)
+				fps |= FPS_Z;
+
+			write_integer(mode, reg, exponent, false);
+			copy_condition_codes();
+			break;
+		}
+
+		case 013: {  // STCFI: truncates, out of range gives 0 + C
+			bool    l      = is_long();
+			double  v      = std::trunc(to_host(get_ac_value(ac_nr, d)));
+			int32_t result = 0;
+
+			fps &= ~(FPS_N | FPS_Z | FPS_V | FPS_C);
+
+			if (l ? v < -2147483648. || v > 2147483647. : v < -32768. || v > 32767.) {
+				fps  |= FPS_C;
+				error = FEC_ICVT;
+			}
+			else {
+				result = int32_t(v);
+			}
+
+			if (result < 0)
+				fps |= FPS_N;
+			else if (result == 0)
+				fps |= FPS_Z;
+
+			write_integer(mode, reg, result, l);
+			copy_condition_codes();
+			break;
+		}
+
+		case 014: {  // STCFD / STCDF: store in the other format
+			uint64_t v = get_ac_value(ac_nr, d);
+
+			if (d)
+				v = check_range(d_to_f(v, chop), (v & FP_EXP_MASK) == 0, &error);
+			else
+				set_fps_nz(v);
+
+			write_operand(get_operand(mode, reg, d ? 4 : 8), v, !d);
+			break;
+		}
+
+		case 015: {  // LDEXP
+			int      exponent = read_integer(mode, reg, false) + 128;
+			uint64_t v        = (ac[ac_nr] & ~FP_EXP_MASK) | (uint64_t(exponent & 0377) << 55);
+
+			set_ac(ac_nr, check_range({ v, exponent }, false, &error), d);
+			break;
+		}
+
+		case 016:  // LDCIF
+			set_ac(ac_nr, round_result(read_integer(mode, reg, is_long()), d, &error), d);
+			break;
+
+		case 017: {  // LDCDF / LDCFD: source is in the other format
+			uint64_t v = read_fsrc(mode, reg, !d);
+
+			if (d)
+				set_fps_nz(v);
+			else
+				v = check_range(d_to_f(v, chop), v == 0, &error);
+
+			set_ac(ac_nr, v, d);
+			break;
+		}
+	}
+
+	if (error)
+		fp_error(error);
+}
+
+std::string fp11::get_mnemonic(const uint16_t instr) const
+{
+	if ((instr & 0170000) != 0170000)
+		return "";
+
+	const char *f_d = is_double() ? "D" : "F";
+	const char *i_l = is_long  () ? "L" : "I";
+	int         operation = (instr >> 8) & 15;
+
+	if (operation == 0) {
+		switch((instr >> 6) & 3) {
+			case 0:
+				switch(instr & 077) {
+					case 000: return "CFCC";
+					case 001: return "SETF";
+					case 011: return "SETD";
+					case 002: return "SETI";
+					case 012: return "SETL";
+				}
+				return "";
+			case 1: return "LDFPS";
+			case 2: return "STFPS";
+			case 3: return "STST";
+		}
+	}
+
+	if (operation == 1) {
+		constexpr const char *const names[] { "CLR", "TST", "ABS", "NEG" };
+		return std::string(names[(instr >> 6) & 3]) + f_d;
+	}
+
+	switch(operation) {
+		case 002: return std::string("MUL") + f_d;
+		case 003: return std::string("MOD") + f_d;
+		case 004: return std::string("ADD") + f_d;
+		case 005: return std::string("LD" ) + f_d;
+		case 006: return std::string("SUB") + f_d;
+		case 007: return std::string("CMP") + f_d;
+		case 010: return std::string("ST" ) + f_d;
+		case 011: return std::string("DIV") + f_d;
+		case 012: return "STEXP";
+		case 013: return std::string("STC") + f_d + i_l;
+		case 014: return is_double() ? "STCDF" : "STCFD";
+		case 015: return "LDEXP";
+		case 016: return std::string("LDC") + i_l + f_d;
+		case 017: return is_double() ? "LDCFD" : "LDCDF";
+	}
+
+	return "";
+}
+
+#if IS_POSIX
+JsonDocument fp11::serialize() const
+{
+	JsonDocument j;
+
+	for(int i=0; i<6; i++)
+		j[format("ac-%d", i)] = ac[i];
+
+	j["fec"] = fec;
+	j["fea"] = fea;
+
+	return j;
+}
+
+void fp11::deserialize(const JsonVariantConst j)
+{
+	for(int i=0; i<6; i++)
+		ac[i] = j[format("ac-%d", i)];
+
+	fec = j["fec"];
+	fea = j["fea"];
+}
+#endif
@@ -0,0 +1,116 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#if IS_POSIX
+#include <ArduinoJson.h>
+#endif
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+
+class bus;
+class cpu;
+
+constexpr const uint16_t FPS_ER  = 0100000;  // error
+constexpr const uint16_t FPS_ID  = 040000;   // interrupt disable
+constexpr const uint16_t FPS_IUV = 04000;    // interrupt on undefined variable (-0)
+constexpr const uint16_t FPS_IU  = 02000;    // interrupt on underflow
+constexpr const uint16_t FPS_IV  = 01000;    // interrupt on overflow
+constexpr const uint16_t FPS_IC  = 0400;     // interrupt on integer conversion error
+constexpr const uint16_t FPS_D   = 0200;     // double precision mode
+constexpr const uint16_t FPS_L   = 0100;     // long integer mode
+constexpr const uint16_t FPS_T   = 040;      // chop (instead of round)
+constexpr const uint16_t FPS_N   = 010;
+constexpr const uint16_t FPS_Z   = 04;
+constexpr const uint16_t FPS_V   = 02;
+constexpr const uint16_t FPS_C   = 01;
+
+// floating exception codes (FEC)
+constexpr const uint16_t FEC_OPCODE   = 2;
+constexpr const uint16_t FEC_DIV_ZERO = 4;
+constexpr const uint16_t FEC_ICVT     = 6;
+constexpr const uint16_t FEC_OVERFLOW = 8;
+constexpr const uint16_t FEC_UNDERFLW = 10;
+constexpr const uint16_t FEC_UNDEF    = 12;
+
+// FP11 floating point processor (11/45, 11/70)
+// the accumulators are kept in the PDP-11 D-format so that loads and stores
+// are bit-exact; arithmetic is done on host doubles and the result is
+// converted back (rounded or chopped as selected by FPS_T).
+// a value is kept "left aligned" in 64 bits: sign, 8 bit exponent (excess
+// 128), 55 bit fraction without the hidden bit. the F-format is the upper
+// 32 bits of that.
+class fp11
+{
+private:
+	cpu *const c { nullptr };
+	bus *const b { nullptr };
+
+	uint64_t ac[6]  {   };  // AC0...5
+	uint16_t fps    { 0 };  // status register
+	uint16_t fec    { 0 };  // error code of the last exception
+	uint16_t fea    { 0 };  // address of the instruction that caused it
+
+	struct fp_operand {
+		bool        is_ac;
+		int         reg;      // accumulator (is_ac) or register for mode 0 integer operands
+		uint16_t    addr;
+		d_i_space_t space;
+		int         n_words;  // words at 'addr' that are part of it (immediate: 1)
+	};
+
+	bool     is_double() const { return fps & FPS_D; }
+	bool     is_long  () const { return fps & FPS_L; }
+
+	bool     fp_error(const uint16_t code);
+	void     set_fps_nz(const uint64_t v);
+	void     copy_condition_codes();  // FPS -> PSW
+	uint64_t get_ac_value(const int nr, const bool d) const;
+	void     set_ac(const int nr, const uint64_t v, const bool d);
+
+	fp_operand get_operand(const int mode, const int reg, const int n_bytes);
+	uint64_t read_operand (const fp_operand & o, const bool d);
+	void     write_operand(const fp_operand & o, const uint64_t v, const bool d);
+	uint64_t read_fsrc    (const int mode, const int reg, const bool d);
+	int32_t  read_integer (const int mode, const int reg, const bool l);
+	void     write_integer(const int mode, const int reg, const int32_t v, const bool l);
+
+	uint64_t check_range (const std::pair<uint64_t, int> & r, const bool is_zero, uint16_t *const error);
+	uint64_t round_result(const double v, const bool d, uint16_t *const error);
+
+	void     misc_instructions          (const uint16_t instr);
+	void     single_operand_instructions(const uint16_t instr);
+	void     accumulator_instructions   (const uint16_t instr);
+
+public:
+	fp11(cpu *const c, bus *const b);
+	~fp11();
+
+#if IS_POSIX
+	JsonDocument serialize() const;
+	void deserialize(const JsonVariantConst j);
+#endif
+
+	void     reset();
+
+	// false if 'instr' is not an FP11 instruction
+	bool     execute(const uint16_t instr);
+
+	uint16_t get_fps() const { return fps; }
+	void     set_fps(const uint16_t v) { fps = v; }
+	uint64_t get_ac (const int nr) const { return ac[nr]; }
+	uint16_t get_fec() const { return fec; }
+	uint16_t get_fea() const { return fea; }
+
+	static double to_host(const uint64_t v);
+	// packed value + exponent that it should have gotten (out of range = over/underflow)
+	static std::pair<uint64_t, int> from_host(const double v, const bool d, const bool chop);
+
+	// e.g. "ADDF" or "ADDD" depending on the current mode, empty if unknown
+	std::string get_mnemonic(const uint16_t instr) const;
+};
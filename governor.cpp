@@ -0,0 +1,46 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+#include "governor.h"
+#include "log.h"
+#include "utils.h"
+
+
+// when the emulation is this far behind (e.g. slow host, debugger pause, a
+// WAIT that took long), don't try to catch up: that would run unthrottled
+constexpr const uint64_t max_lag_us = 50000;
+
+governor::governor(const double speed_factor, const uint32_t interval_us) :
+	speed_factor(speed_factor),
+	interval_ns(uint64_t(interval_us * 1000 * speed_factor))
+{
+	reset();
+}
+
+governor::~governor()
+{
+}
+
+void governor::reset()
+{
+	pending_ns  = 0;
+	emulated_ns = 0;
+	start_us    = get_us();
+}
+
+void governor::sync()
+{
+	emulated_ns += pending_ns;
+	pending_ns   = 0;
+
+	uint64_t target_us = uint64_t(emulated_ns / 1000 / speed_factor);
+	uint64_t now_us    = get_us() - start_us;
+
+	if (target_us > now_us)
+		myusleep(target_us - now_us);
+	else if (now_us - target_us > max_lag_us) {
+		DOLOG(log_ss::LS_CPU, "Speed governor: %.3f ms behind, restarting", (now_us - target_us) / 1000.);
+		reset();
+	}
+}
@@ -0,0 +1,31 @@
+// (C) 2018-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include <cstdint>
+
+
+// keeps the emulated time (as summed by the cpu from calc_instruction_duration)
+// at a fixed ratio to the wall clock. the comparison (and sleep) is only done
+// once every 'interval' of emulated time, not for each instruction.
+class governor
+{
+private:
+	const double   speed_factor;      // 1.0 is a real 11/70
+	const uint64_t interval_ns;
+	uint64_t       pending_ns  { 0 };  // emulated, not yet compared
+	uint64_t       emulated_ns { 0 };  // since 'start_us'
+	uint64_t       start_us    { 0 };
+
+	void sync();
+
+public:
+	governor(const double speed_factor, const uint32_t interval_us = 4000);
+	~governor();
+
+	double get_speed_factor() const { return speed_factor; }
+
+	void add(const uint32_t ns) { pending_ns += ns; if (pending_ns >= interval_ns) [[unlikely]] sync(); }
+	void reset();  // forget the past, e.g. after the emulation was paused
+};
@@ -10,6 +10,7 @@
 
 #include "console.h"
 #include "cpu.h"
+#include "event_scheduler.h"
 #include "kw11-l.h"
 #include "log.h"
 #include "utils.h"
@@ -59,6 +60,10 @@ kw11_l::kw11_l(bus *const b): b(b)
 kw11_l::~kw11_l()
 {
 	stop_flag = true;
+
+	if (tick_event && b->getCpu())
+		b->getCpu()->get_scheduler()->cancel(tick_event);
+
 #if defined(ESP32)
 	esp_timer_delete(kw11l_periodic_timer);
 #elif defined(TEENSY4_1)
@@ -96,6 +101,8 @@ void kw11_l::begin(console *const cnsl)
 #endif
 #endif
 
+	// also when driven by the cpu: tick() ignores the wall clock then, and
+	// set_wall_clock() can switch back at any time
 #if defined(ESP32)
 	const esp_timer_create_args_t periodic_timer_args = {
 		.callback = &periodic_timer_callback,
@@ -127,6 +134,32 @@ void kw11_l::begin(console *const cnsl)
 #endif
 }
 
+// when not on the wall clock, the ticks are events on the cpu's scheduler
+void kw11_l::set_wall_clock(const bool state)
+{
+	cpu *c = b->getCpu();
+
+	if (tick_event) {
+		c->get_scheduler()->cancel(tick_event);
+		tick_event = 0;
+	}
+
+	wall_clock = state;
+
+	if (state == false)
+		schedule_virtual_tick();
+}
+
+void kw11_l::schedule_virtual_tick()
+{
+	cpu *c = b->getCpu();
+
+	tick_event = c->get_scheduler()->schedule(c->get_event_time() + c->us_to_event_time(1000000 / std::max(1, int(int_frequency))), [this] {
+			schedule_virtual_tick();
+			tick(true);
+		});
+}
+
 void kw11_l::reset(const bool hard)
 {
 	if (hard) {
@@ -144,6 +177,9 @@ void kw11_l::do_interrupt()
 		int_triggered++;
 		b->getCpu()->queue_interrupt(6, 0100);
 	}
+	else {
+		b->getCpu()->wake_up();  // may be polling bit 7
+	}
 }
 
 int kw11_l::get_interrupt_frequency()
@@ -151,8 +187,11 @@ int kw11_l::get_interrupt_frequency()
 	return int_frequency;
 }
 
-void kw11_l::tick()
+void kw11_l::tick(const bool is_virtual)
 {
+	if (is_virtual == wall_clock)  // not the selected time source
+		return;
+
 	total_ticks++;
 
 	cnsl->set_LED_state(false);
@@ -301,21 +340,24 @@ uint8_t kw11_l::get_lf_crs()
 JsonDocument kw11_l::serialize()
 {
 	JsonDocument j;
-	j["CSR"       ] = lf_csr;
-	j["wall-clock"] = wall_clock;
+	j["CSR"] = lf_csr;
 	return j;
 }
 
+// the time source is not part of the state: it follows the current setting
+// of the cpu (-K), see cpu::set_virtual_line_clock()
 kw11_l *kw11_l::deserialize(const JsonVariantConst j, bus *const b, console *const cnsl)
 {
-	uint16_t CSR        = j["CSR"       ];
-	bool     wall_clock = j["wall-clock"];
+	uint16_t CSR = j["CSR"];
 
 	kw11_l *out  = new kw11_l(b);
-	out->lf_csr     = CSR;
-	out->wall_clock = wall_clock;
+	out->lf_csr  = CSR;
 	out->begin(cnsl);
 
+	cpu *c = b->getCpu();
+	if (c)
+		out->set_wall_clock(c->get_virtual_line_clock().has_value() == false);
+
 	return out;
 }
 #endif
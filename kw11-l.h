@@ -30,7 +30,8 @@ private:
 #endif
 	aint               int_frequency { 50   };
 	uint16_t           lf_csr     { 0       };
-	bool               wall_clock { true    };
+	abool              wall_clock { true    };  // false: ticks come from the cpu
+	uint64_t           tick_event { 0       };  // event_scheduler id
 
 	uint64_t           total_ticks   { 0       };
 	uint64_t           enabled_ticks { 0       };
@@ -45,6 +46,7 @@ private:
 	void     set_lf_crs_b7();
 
 	void     do_interrupt();
+	void     schedule_virtual_tick();
 
 public:
 	kw11_l(bus *const b);
@@ -63,7 +65,10 @@ public:
 #endif
 
 	void     begin(console *const cnsl);
-	void     tick();
+	// 'is_virtual': invoked by the cpu, see cpu::set_virtual_line_clock()
+	void     tick(const bool is_virtual = false);
+	void     set_wall_clock(const bool state);
+	bool     get_wall_clock() const { return wall_clock; }
 #if !defined(TEENSY4_1)
 	void     operator()();
 #endif
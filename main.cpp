@@ -18,7 +18,9 @@
 #include "comm.h"
 #include "comm_posix_tty.h"
 #include "comm_pst.h"
+#include "comm_pty.h"
 #include "comm_tcp_socket_server.h"
+#include "comm_unix_socket.h"
 #if defined(USE_IMGUI)
 #include "console_imgui.h"
 #endif
@@ -157,6 +159,7 @@ int run_cpu_validation(console *const cnsl, const std::string & filename)
 		b->set_memory_size(DEFAULT_N_PAGES);
 		cpu *c = new cpu(b, &event);
 		b->add_cpu(c);
+		c->set_allow_block_loops(false);  // exactly 'run-n-instructions'
 
 		// SET
 		json_t *before = json_object_get(element, "before");
@@ -255,6 +258,19 @@ void start_disk_devices(const std::vector<disk_backend *> & backends, const bool
 	}
 }
 
+// -U / -Y: a line on a unix domain socket or a pty instead of a tcp port. they
+// are numbered as the ports would be: DZ11 lines first, then the DC11.
+comm *create_local_comm(const std::optional<std::string> & unix_prefix, const std::optional<std::string> & pty_prefix, const int nr)
+{
+#if IS_POSIX
+	if (unix_prefix.has_value())
+		return new comm_unix_socket(unix_prefix.value() + std::to_string(nr));
+	if (pty_prefix.has_value())
+		return new comm_pty(pty_prefix.value() + std::to_string(nr));
+#endif
+	return nullptr;
+}
+
 void help()
 {
 	printf("-h       this help\n");
@@ -273,6 +289,9 @@ void help()
 	printf("-d       enable debugger\n");
 	printf("-f x     first process the commands from file x before entering the debugger\n");
 	printf("-S x     set ram size (in number of 8 kB pages)\n");
+	printf("-M x     CPU model: 11/70 (default), 11/45, 11/40 or 11/34\n");
+	printf("-G x     run at x times the speed of a real 11/70 (e.g. 1, 2.5), default is as fast as possible\n");
+	printf("-K x     let the KW11-L tick on emulated time (x instructions per second, e.g. 1000000) instead of on the wall clock\n");
 	printf("-s x,y   set console switche state: set bit x (0...15) to y (0/1)\n");
 	printf("-t       enable tracing (disassemble to stderr, requires -d as well)\n");
 	printf("-l x     log to file x\n");
@@ -288,6 +307,8 @@ void help()
 	printf("-8 x     setup a blinkenlights/PiDP11 connection on IP-address x\n");
 	printf("-9 x|n   setup a DDP (e.g. WLED) connection on IP-address x for n LEDs\n");
 	printf("-Q x     use x as port offset instead of %d\n", default_port_offset);
+	printf("-U x     put the DZ-11 and DC-11 lines on unix domain sockets x0, x1, ... instead of tcp-sockets\n");
+	printf("-Y x     put the DZ-11 and DC-11 lines on ptys, symlinked as x0, x1, ..., instead of tcp-sockets\n");
 	printf("-I x[,y,z,[a]] setup a DEQNA device with Ethernet type x ('linux' (tap), 'vxlan': y=ip,z=port,a=id)\n");
 }
 
@@ -330,6 +351,10 @@ int main(int argc, char *argv[])
 
 	std::optional<int> set_ram_size;
 
+	cpu_model_t  cpu_model = cm_11_70;
+	std::optional<double> speed_factor;
+	std::optional<uint32_t> virtual_clock_ips;
+
 	std::string  validate_json;
 
 	std::string  deserialize;
@@ -340,11 +365,13 @@ int main(int argc, char *argv[])
 	std::string  psti_device;
 
 	int          tcp_port_offset = default_port_offset;
+	std::optional<std::string> comm_unix_prefix;
+	std::optional<std::string> comm_pty_prefix;
 
 	std::string  deqna_type;
 
 	int  opt = -1;
-	while((opt = getopt(argc, argv, "u:hC:L:D:T:B:r:R:p:df:tb:l:s:Q:N:J:XS:P1:m:Q:28:9:6:I:c:")) != -1)
+	while((opt = getopt(argc, argv, "u:hC:L:D:T:B:r:R:p:df:tb:l:s:Q:N:J:XS:P1:m:Q:28:9:6:I:c:M:G:K:U:Y:")) != -1)
 	{
 		switch(opt) {
 			case 'h':
@@ -355,6 +382,14 @@ int main(int argc, char *argv[])
 				tcp_port_offset = atoi(optarg);
 				break;
 
+			case 'U':
+				comm_unix_prefix = optarg;
+				break;
+
+			case 'Y':
+				comm_pty_prefix = optarg;
+				break;
+
 			case 'f':
 				debugger_init = optarg;
 				break;
@@ -488,6 +523,26 @@ int main(int argc, char *argv[])
 				disk_snapshots = true;
 				break;
 
+			case 'M': {
+					  auto model = find_cpu_model(optarg);
+					  if (model.has_value() == false)
+						  error_exit(false, "-M: CPU model \"%s\" is not known", optarg);
+					  cpu_model = model.value();
+				  }
+				  break;
+
+			case 'G':
+				speed_factor = std::stod(optarg);
+				if (speed_factor.value() <= 0)
+					error_exit(false, "-G: speed factor must be > 0");
+				break;
+
+			case 'K':
+				virtual_clock_ips = std::stoul(optarg);
+				if (virtual_clock_ips.value() == 0)
+					error_exit(false, "-K: number of instructions per second must be > 0");
+				break;
+
 			case '6':
 				psti_device = optarg;
 				break;
@@ -588,10 +643,18 @@ int main(int argc, char *argv[])
 	if (deserialize.empty()) {
 		b = new bus();
 
-		if (set_ram_size.has_value())
+		b->set_cpu_model(cpu_model);
+
+		if (set_ram_size.has_value()) {
+			// without 22 bit mapping, everything above 248 kB would be the I/O page
+			if (cpu_models[cpu_model].has_22bit == false && set_ram_size.value() > 31)
+				error_exit(false, "A PDP-%s can address at most 31 pages (248 kB) of RAM", cpu_models[cpu_model].name);
+
 			b->set_memory_size(set_ram_size.value());
-		else
+		}
+		else {
 			b->set_memory_size(DEFAULT_N_PAGES);
+		}
 
 		b->set_console_switches(console_switches);
 
@@ -727,6 +790,13 @@ int main(int argc, char *argv[])
 	for(size_t i=0; i<dz11_n_lines; i++) {
 		if (io_channels->is_defined(i))
 			continue;
+		comm *local = create_local_comm(comm_unix_prefix, comm_pty_prefix, i);
+		if (local) {
+			DOLOG(log_ss::LS_COMM, "Configuring DZ11 device for %s", local->get_identifier().c_str());
+			if (io_channels->set_device(i, local) == false)
+				DOLOG(log_ss::LS_COMM, "Failed to configure device");
+			continue;
+		}
 		int port = tcp_port_offset + i;
 		DOLOG(log_ss::LS_COMM, "Configuring DZ11 device for TCP socket on port %d", port);
 		if (io_channels->set_device(i, new comm_tcp_socket_server(port, dz11_setup_telnet)) == false)
@@ -742,6 +812,13 @@ int main(int argc, char *argv[])
 	for(size_t i=0; i<dc11_n_lines; i++) {
 		if (io_channels2->is_defined(i))
 			continue;
+		comm *local = create_local_comm(comm_unix_prefix, comm_pty_prefix, i + dz11_n_lines);
+		if (local) {
+			DOLOG(log_ss::LS_GENERIC, "Configuring DC11 device for %s", local->get_identifier().c_str());
+			if (io_channels2->set_device(i, local) == false)
+				DOLOG(log_ss::LS_GENERIC, "Failed to configure device");
+			continue;
+		}
 		int port = tcp_port_offset + i + dz11_n_lines;
 		DOLOG(log_ss::LS_GENERIC, "Configuring DC11 device for TCP socket on port %d", port);
 		if (io_channels2->set_device(i, new comm_tcp_socket_server(port, dc11_setup_telnet)) == false)
@@ -782,6 +859,12 @@ int main(int argc, char *argv[])
 	if (start_addr.has_value())
 		b->getCpu()->set_register(7, start_addr.value());
 
+	if (speed_factor.has_value())
+		b->getCpu()->set_speed_factor(speed_factor.value());
+
+	if (virtual_clock_ips.has_value())
+		b->getCpu()->set_virtual_line_clock(virtual_clock_ips.value());
+
 	DOLOG(log_ss::LS_GENERIC, "Start running at %06o", b->getCpu()->get_register(7));
 
 #if defined(_WIN32)
@@ -819,6 +902,8 @@ int main(int argc, char *argv[])
 				while(event == EVENT_NONE)
 					c->step();
 
+				cnsl->flush_output();  // what the guest printed last may still be buffered
+
 				*running = false;
 
 				uint32_t stop_event = event;
@@ -8,6 +8,7 @@
 #include <ArduinoJson.h>
 #endif
 #include <cstdint>
+#include <cstring>
 #if defined(BUILD_FOR_PICO2W) || defined(TEENSY4_1)  // TODO also teensy4.1?
 #define __LITTLE_ENDIAN 1
 #define __BYTE_ORDER __LITTLE_ENDIAN
@@ -37,6 +38,11 @@ public:
 	uint16_t read_byte(const uint32_t a) const { return m[a]; }
 	void write_byte(const uint32_t a, const uint16_t v) { m[a] = v; }
 
+	// block operations; byte order does not matter for these
+	void move (const uint32_t dst, const uint32_t src, const uint32_t n) { memmove(&m[dst], &m[src], n); }
+	void clear(const uint32_t a, const uint32_t n) { memset(&m[a], 0x00, n); }
+	void write_block(const uint32_t a, const uint8_t *const data, const uint32_t n) { memcpy(&m[a], data, n); }
+
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 	uint16_t read_word(const uint32_t a) const { return *reinterpret_cast<uint16_t *>(&m[a]); }
 	void write_word(const uint32_t a, const uint16_t v) { *reinterpret_cast<uint16_t *>(&m[a]) = v; }
@@ -27,6 +27,19 @@ void mmu::begin(memory *const m, cpu *const c)
 	reset(true);
 }
 
+void mmu::set_cpu_model(const cpu_model_features_t & features)
+{
+	if (features.has_22bit)
+		MMR3_mask = 0177777;
+	else
+		MMR3_mask = features.has_id_space ? 7 : 0;
+
+	PAR_mask = features.has_22bit ? 0177777 : 07777;
+
+	MMR3 &= MMR3_mask;
+	update_io_base();
+}
+
 void mmu::reset(const bool hard)
 {
 	if (hard) {
@@ -63,8 +76,8 @@ FLASHMEM void mmu::show_state(console *const cnsl) const
 	cnsl->put_string_lf(MMR0 & 1 ? "MMU enabled" : "MMU NOT enabled");
 
 	cnsl->put_string_lf(format("MMR0: %06o", MMR0));
-	cnsl->put_string_lf(format("MMR1: %06o", MMR1));
-	cnsl->put_string_lf(format("MMR2: %06o", MMR2));
+	cnsl->put_string_lf(format("MMR1: %06o", getMMR1()));
+	cnsl->put_string_lf(format("MMR2: %06o", getMMR2()));
 	cnsl->put_string_lf(format("MMR3: %06o", MMR3));
 
 	dump_par_pdr(cnsl, 1, i_space, "supervisor i-space", 0,                  { });
@@ -93,8 +106,18 @@ uint16_t mmu::read_par(const uint32_t a, const int run_mode)
 	return pages[page_index].par_preshifted >> 6;
 }
 
+// MMR1/2 are only materialized when an abort locks them
+void mmu::freeze_MMR1_MMR2(const uint16_t new_MMR0)
+{
+	if (is_locked() == false && (new_MMR0 & 0160000) && c) {
+		MMR1 = c->get_MMR1_log();
+		MMR2 = c->get_instruction_start();
+	}
+}
+
 void mmu::setMMR0_as_is(uint16_t value)
 {
+	freeze_MMR1_MMR2(value);
 	MMR0 = value;
 	update_io_base();
 }
@@ -111,6 +134,7 @@ void mmu::setMMR0(uint16_t value)
 			value &= 254;  // bits 7...1 are protected 
 	}
 
+	freeze_MMR1_MMR2(value);
 	MMR0 = value;
 	update_io_base();
 }
@@ -127,7 +151,7 @@ void mmu::setMMR2(const uint16_t value)
 
 void mmu::setMMR3(const uint16_t value) 
 {
-	MMR3 = value;
+	MMR3 = value & MMR3_mask;
 	update_io_base();
 }
 
@@ -136,23 +160,6 @@ bool mmu::get_use_data_space(const int run_mode) const
 	return MMR3 & di_ena_mask[run_mode];
 }
 
-void mmu::clearMMR1()
-{
-	MMR1 = 0;
-}
-
-void mmu::add_to_MMR1(const int8_t delta, const uint8_t reg)
-{
-	assert(reg >= 0 && reg <= 7);
-	assert(delta >= -2 && delta <= 2);
-
-	assert((getMMR0() & 0160000) == 0);  // MMR1 should not be locked
-
-	MMR1 <<= 8;
-	MMR1 |= (delta & 31) << 3;
-	MMR1 |= reg;
-}
-
 void mmu::write_pdr(const uint32_t a, const int run_mode, const uint16_t value, const word_mode_t word_mode)
 {
 	d_i_space_t d          = a & 16 ? d_space : i_space;
@@ -169,6 +176,7 @@ void mmu::write_pdr(const uint32_t a, const int run_mode, const uint16_t value,
 	}
 
 	pages[page_index].pdr &= ~(32768 + 128 /*A*/ + 64 /*W*/ + 32 + 16);  // set bit 4, 5 & 15 to 0 as they are unused and A/W are set to 0 by writes
+	mapping_generation++;
 
 	DOLOG(log_ss::LS_MMU, "mmu WRITE-I/O PDR run-mode %d: %c for %d: %o [%d]", run_mode, d == d_space ? 'D' : 'I', page, value, word_mode);
 }
@@ -182,13 +190,14 @@ void mmu::write_par(const uint32_t a, const int run_mode, const uint16_t value,
 	if (word_mode == wm_byte) {
 		uint16_t par = pages[page_index].par_preshifted >> 6;
 		update_word(&par, a & 1, value);
-		pages[page_index].par_preshifted = par << 6;
+		pages[page_index].par_preshifted = (par & PAR_mask) << 6;
 	}
 	else {
-		pages[page_index].par_preshifted = value << 6;
+		pages[page_index].par_preshifted = (value & PAR_mask) << 6;
 	}
 
 	pages[page_index].pdr &= ~(128 /*A*/ + 64 /*W*/);  // reset PDR A/W when PAR is written to
+	mapping_generation++;
 
 	DOLOG(log_ss::LS_MMU, "mmu WRITE-I/O PAR run-mode %d: %c for %d: %o (%07o)", run_mode, d == d_space ? 'D' : 'I', page, word_mode == wm_byte ? value & 0xff : value, pages[page_index].par_preshifted);
 }
@@ -413,6 +422,34 @@ void mmu::verify_page_length(const uint16_t virt_addr, const ppi_t page_index)
 	}
 }
 
+std::optional<std::pair<uint32_t, int> > mmu::probe_physical_address(const int run_mode, const uint16_t a, const d_i_space_t space)
+{
+	if (is_enabled() == false)
+		return { { a, a >> 13 } };
+
+	uint16_t p_offset   = a & 8191;  // page offset
+	uint8_t  apf        = a >> 13;  // active page field
+	ppi_t    page_index = calc_par_pdr_index(run_mode, space, apf);
+
+	uint32_t m_offset   = get_physical_memory_offset(page_index);
+	m_offset += p_offset;
+
+	if ((getMMR3() & 16) == 0)  // off is 18bit
+		m_offset &= 0x3ffff;
+
+	if (get_trap_action(page_index, false).first != T_PROCEED)
+		return { };
+
+	uint16_t pdr_len   = get_pdr_len(page_index);
+	uint16_t pdr_cmp   = (a >> 6) & 127;
+	bool     direction = get_pdr_direction(page_index);
+
+	if (direction == false ? pdr_cmp > pdr_len : pdr_cmp < pdr_len)
+		return { };
+
+	return { { m_offset, page_index } };
+}
+
 std::pair<uint32_t, int> mmu::calculate_physical_address(const int run_mode, const uint16_t a, const bool is_write, const d_i_space_t space)
 {
 	if (is_enabled() || (is_write && (getMMR0() & (1 << 8 /* maintenance check */)))) {
@@ -473,8 +510,8 @@ JsonDocument mmu::serialize() const
 	}
 
         j["MMR0"]   = MMR0;
-        j["MMR1"]   = MMR1;
-        j["MMR2"]   = MMR2;
+        j["MMR1"]   = getMMR1();
+        j["MMR2"]   = getMMR2();
         j["MMR3"]   = MMR3;
         j["CPUERR"] = CPUERR;
         j["PIR"]    = PIR;
@@ -525,11 +562,3 @@ mmu *mmu::deserialize(const JsonVariantConst j, memory *const mem, cpu *const c)
 	return m;
 }
 #endif
-
-void mmu::MMRStartInstruction(const uint16_t pc)
-{
-	if (!isMMR1Locked()) {
-		setMMR2(pc);
-		clearMMR1();
-	}
-}
@@ -5,8 +5,10 @@
 #include <ArduinoJson.h>
 #endif
 #include <cstdint>
+#include <optional>
 #include <string>
 #include "cpu.h"
+#include "cpu_model.h"
 #include "device.h"
 #include "memory.h"
 
@@ -59,6 +61,11 @@ private:
 	uint16_t PIR     { 0 };
 	uint16_t CSR     { 0 };
 	uint32_t io_base { 0 };
+	uint32_t mapping_generation { 0 };  // changes whenever a virtual to physical mapping may have changed
+
+	// what the selected CPU model implements; an 18 bit model has 12 bit PARs
+	uint16_t MMR3_mask { 0177777 };
+	uint16_t PAR_mask  { 0177777 };
 
 	memory  *m      { nullptr };
 	cpu     *c      { nullptr };
@@ -68,7 +75,9 @@ private:
 	void set_par_pdr(const JsonVariantConst j_in, const int run_mode, const d_i_space_t d);
 #endif
 
-	void update_io_base() { io_base = is_enabled() ? (getMMR3() & 16 ? 017760000 : 0760000) : 0160000; }
+	void update_io_base() { io_base = is_enabled() ? (getMMR3() & 16 ? 017760000 : 0760000) : 0160000; mapping_generation++; }
+
+	void freeze_MMR1_MMR2(const uint16_t new_MMR0);
 
 	void verify_page_access(const ppi_t page_index, const bool is_write);
 	void verify_page_length(const uint16_t virt_addr, const ppi_t page_index);
@@ -78,6 +87,7 @@ public:
 	virtual ~mmu();
 
 	void     begin(memory *const m, cpu *const c);
+	void     set_cpu_model(const cpu_model_features_t & features);
 
 #if IS_POSIX
 	JsonDocument serialize() const;
@@ -104,14 +114,18 @@ public:
 	uint32_t get_physical_memory_offset(const ppi_t page_index) const { return pages[page_index].par_preshifted; }
 	bool     get_use_data_space(const int run_mode) const;
 	uint32_t get_io_base() const { return io_base; }
+	uint32_t get_mapping_generation() const { return mapping_generation; }
 
 	memory_addresses_t            calculate_physical_address(const int run_mode, const uint16_t a) const;
 	std::pair<trap_action_t, int> get_trap_action(const int page_index, const bool is_write);
 	std::pair<uint32_t, int>      calculate_physical_address(const int run_mode, const uint16_t a, const bool is_write, const d_i_space_t space);
+	// same translation, but empty instead of a trap when the access would not proceed
+	std::optional<std::pair<uint32_t, int> > probe_physical_address(const int run_mode, const uint16_t a, const d_i_space_t space);
 
 	inline uint16_t getMMR0()  const { return  MMR0; }
-	inline uint16_t getMMR1()  const { return  MMR1; }
-	inline uint16_t getMMR2()  const { return  MMR2; }
+	// while not locked, MMR1/2 follow the instruction that is being executed
+	inline uint16_t getMMR1()  const { return is_locked() || !c ? MMR1 : c->get_MMR1_log();          }
+	inline uint16_t getMMR2()  const { return is_locked() || !c ? MMR2 : c->get_instruction_start(); }
 	inline uint16_t getMMR3()  const { return  MMR3; }
 
 	void     setMMR0_as_is(uint16_t value);
@@ -120,11 +134,7 @@ public:
 	void     setMMR2(const uint16_t value);
 	void     setMMR3(const uint16_t value);
 
-	void     MMRStartInstruction(const uint16_t pc);
-
 	bool     isMMR1Locked() const { return MMR0 & 0160000; }
-	void     clearMMR1();
-	void     add_to_MMR1(const int8_t delta, const uint8_t reg);
 
 	void     trap_if_odd(const int page_index);
 
@@ -77,6 +77,24 @@ public:
 #endif
 	}
 
+	// one lock and one wake-up for the whole batch
+	void push_all(const T *const values, const size_t n) {
+#if defined(FREERTOS)
+		for(size_t i=0; i<n; i++) {
+			if (xQueueSend(q, &values[i], portMAX_DELAY) != pdPASS)
+				DOLOG(log_ss::LS_GENERIC, "xQueueSend failed");
+		}
+#else
+		if (n == 0)
+			return;
+
+		std::unique_lock<std::mutex> lck(l);
+		q.insert(q.end(), values, values + n);
+		lck.unlock();
+		cv.notify_one();
+#endif
+	}
+
 	std::optional<T> pop(const int timeout_ms) {
 #if defined(FREERTOS)
 		T c { };
@@ -0,0 +1,66 @@
+// (C) 2024-2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// byte ring buffer without locking for exactly one producer thread (write())
+// and one consumer thread (read()). 'N' must be a power of 2.
+template<size_t N>
+class spsc_ring
+{
+private:
+	static_assert((N & (N - 1)) == 0, "N must be a power of 2");
+
+	uint8_t             buffer[N] { };
+	std::atomic<size_t> head      { 0 };  // only changed by the producer
+	std::atomic<size_t> tail      { 0 };  // only changed by the consumer
+
+public:
+	spsc_ring() {
+	}
+
+	~spsc_ring() {
+	}
+
+	size_t get_used() const { return head - tail; }
+	size_t get_free() const { return N - get_used(); }
+	bool   is_empty() const { return head == tail; }
+
+	// returns how many bytes were stored, less than 'n' when full
+	size_t write(const uint8_t *const in, const size_t n) {
+		size_t h    = head;
+		size_t todo = std::min(n, N - (h - tail));
+
+		size_t offset = h & (N - 1);
+		size_t first  = std::min(todo, N - offset);
+		memcpy(&buffer[offset], in, first);
+		memcpy(&buffer[0], in + first, todo - first);
+
+		head = h + todo;
+
+		return todo;
+	}
+
+	// returns how many bytes were retrieved, 0 when empty
+	size_t read(uint8_t *const out, const size_t n) {
+		size_t t    = tail;
+		size_t todo = std::min(n, head - t);
+
+		size_t offset = t & (N - 1);
+		size_t first  = std::min(todo, N - offset);
+		memcpy(out, &buffer[offset], first);
+		memcpy(out + first, &buffer[0], todo - first);
+
+		tail = t + todo;
+
+		return todo;
+	}
+};
@@ -6,7 +6,9 @@
 #include <unistd.h>
 
 #include "tty.h"
+#include "comm.h"
 #include "cpu.h"
+#include "event_scheduler.h"
 #include "gen.h"
 #include "log.h"
 #include "memory.h"
@@ -22,7 +24,8 @@ const char * const regnames[] = {
 
 tty::tty(console *const c, bus *const b) :
 	c(c),
-	b(b)
+	b(b),
+	tx_flush(b, comm_tx_flush_us, [c] { c->flush_output(); })
 {
 	reset(true);
 	c->set_data_cb_notifier(this);
@@ -30,6 +33,7 @@ tty::tty(console *const c, bus *const b) :
 
 tty::~tty()
 {
+	tx_flush.cancel();
 }
 
 void tty::reset(const bool hard)
@@ -46,12 +50,19 @@ uint8_t tty::read_byte(const uint16_t addr)
 	return v;
 }
 
+void tty::flush_tx()
+{
+	tx_flush.flush_now();
+}
+
 void tty::notify_rx()
 {
 	registers[(PDP11TTY_TKS - PDP11TTY_BASE) / 2] |= 128;
 
 	if (registers[(PDP11TTY_TKS - PDP11TTY_BASE) / 2] & 64)
 		b->getCpu()->queue_interrupt(4, 060);
+	else
+		b->getCpu()->wake_up();  // may be polling TKS
 }
 
 uint16_t tty::read_word(const uint16_t addr)
@@ -61,13 +72,17 @@ uint16_t tty::read_word(const uint16_t addr)
 	bool      notify = false;
 
 	if (addr == PDP11TTY_TKS) {
+		flush_tx();  // e.g. a prompt before waiting for what the user types
+
 		bool have_char = c->poll_char();
 
 		vtemp &= ~128;
 		vtemp |= have_char ? 128 : 0;
 	}
 	else if (addr == PDP11TTY_TKB) {
-		auto ch = c->wait_char(1);
+		flush_tx();
+
+		auto ch = c->try_get_char();
 		if (ch.has_value() == false)
 			vtemp = 0;
 		else {
@@ -115,7 +130,8 @@ void tty::write_word(const uint16_t addr, uint16_t v)
 	if (addr == PDP11TTY_TPB) {
 		char ch = v & 127;
 		DOLOG(log_ss::LS_COMM, "PDP11TTY print '%c'", ch);
-		c->put_char(ch);
+		c->put_char(ch, false);
+		tx_flush.written();
 
 		registers[(PDP11TTY_TPS - PDP11TTY_BASE) / 2] |= 128;
 
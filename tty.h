@@ -16,6 +16,7 @@
 
 #include "bus.h"
 #include "console.h"
+#include "tx_flush_timer.h"
 
 
 #define PDP11TTY_TKS		0177560	// reader status
@@ -35,6 +36,10 @@ private:
 
 	uint16_t registers[4] { 0 };
 
+	tx_flush_timer tx_flush;  // sends what put_char() buffered
+
+	void flush_tx();
+
 public:
 	tty(console *const c, bus *const b);
 	virtual ~tty();
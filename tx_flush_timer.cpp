@@ -0,0 +1,79 @@
+// (C) 2026 by Folkert van Heusden
+// Released under MIT license
+
+#include "gen.h"
+
+#include "bus.h"
+#include "cpu.h"
+#include "event_scheduler.h"
+#include "tx_flush_timer.h"
+
+
+tx_flush_timer::tx_flush_timer(bus *const b, const int idle_us, const std::function<void()> & flush):
+	b(b),
+	idle_us(idle_us),
+	flush(flush)
+{
+}
+
+tx_flush_timer::~tx_flush_timer()
+{
+	cancel();
+}
+
+void tx_flush_timer::arm(const uint64_t due)
+{
+	event_id = b->getCpu()->get_scheduler()->schedule(due, [this, due] { expired(due); });
+}
+
+// one event for a burst of output: it is not moved for every write, it
+// looks at the time of the last write when it expires
+void tx_flush_timer::written()
+{
+	cpu *const c = b->getCpu();
+
+	last_write = c->get_event_time();
+
+	if (event_id == 0)
+		arm(last_write + c->us_to_event_time(idle_us));
+}
+
+void tx_flush_timer::expired(const uint64_t due)
+{
+	event_id = 0;
+
+	cpu *const  c    = b->getCpu();
+	uint64_t    now  = c->get_event_time();
+	uint64_t    idle = last_write + c->us_to_event_time(idle_us);
+
+	// invoked before it was due means that the cpu is waiting (WAIT or an
+	// idle loop): the guest is not going to write anything for now
+	if (now >= due && idle > now) {  // still writing
+		arm(idle);
+		return;
+	}
+
+	flush();
+}
+
+void tx_flush_timer::flush_now()
+{
+	if (event_id == 0)
+		return;
+
+	cancel();
+
+	flush();
+}
+
+void tx_flush_timer::cancel()
+{
+	if (event_id == 0)
+		return;
+
+	cpu *const c = b->getCpu();
+	if (c)
+		c->get_scheduler()->cancel(event_id);
+
+	event_id = 0;
+}
@@ -0,0 +1,35 @@
+// (C) 2026 by Folkert van Heusden
+// Released under MIT license
+
+#pragma once
+
+#include "gen.h"
+#include <cstdint>
+#include <functional>
+
+
+class bus;
+
+// buffered terminal output is sent when the guest has not written anything
+// for 'idle_us' (emulated time), or earlier via flush_now(). only to be used
+// from the cpu thread, as the event it schedules runs there as well.
+class tx_flush_timer
+{
+private:
+	bus                  *const b;
+	const int             idle_us;
+	std::function<void()> flush;
+	uint64_t              event_id   { 0 };  // event_scheduler id, 0 when nothing is buffered
+	uint64_t              last_write { 0 };  // event time
+
+	void arm(const uint64_t due);
+	void expired(const uint64_t due);
+
+public:
+	tx_flush_timer(bus *const b, const int idle_us, const std::function<void()> & flush);
+	~tx_flush_timer();
+
+	void written();  // something was buffered
+	void flush_now();
+	void cancel();
+};